@@ -2,59 +2,254 @@
 #include "BinaryData.h"
 #include "utils/AIAlert.h"
 #include "utils/c_escape.h"
+#include "utils/print_using.h"
 #include "debug.h"
-#include <boost/archive/iterators/base64_from_binary.hpp>
-#include <boost/archive/iterators/binary_from_base64.hpp>
-#include <boost/archive/iterators/transform_width.hpp>
 #include <boost/archive/iterators/xml_escape.hpp>
 #include <boost/archive/iterators/escape.hpp>
+#include <array>
+#include <cstdint>
 #include <iostream>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 using namespace boost::archive::iterators;
 
 namespace {
 
-// Convert 0 --> 0, 1 --> 2 and 2 --> 1 by swapping the last two bits.
-unsigned int required_padding(int n)
+char const base64_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+constexpr uint8_t base64_invalid = 0xff;
+constexpr uint8_t base64_padding = 0xfe;
+constexpr uint8_t base64_whitespace = 0xfd;
+
+// Map each character to its six bit value, or one of the above.
+constexpr std::array<uint8_t, 256> make_base64_decode_table()
 {
-  return ((n << 1) | (n >> 1)) & 3;
+  std::array<uint8_t, 256> table{};
+  for (auto& entry : table)
+    entry = base64_invalid;
+  for (int i = 0; i < 64; ++i)
+    table[static_cast<unsigned char>(base64_alphabet[i])] = i;
+  table['='] = base64_padding;
+  for (unsigned char c : { ' ', '\t', '\n', '\r' })
+    table[c] = base64_whitespace;
+  return table;
 }
 
-// Replace all '=' with 'A'.
-template<class Base>
-class convert : public escape<convert<Base>, Base>
+constexpr std::array<uint8_t, 256> base64_decode_table = make_base64_decode_table();
+
+#if defined(__AVX2__) || defined(__SSSE3__)
+// The SIMD code below uses the algorithms of Wojciech Muła and Daniel Lemire ("Faster Base64 Encoding and Decoding using AVX2 Instructions").
+// The AVX2 versions do the same as the SSSE3 versions on both 128 bit lanes.
+#if defined(__AVX2__)
+using vec_t = __m256i;
+#define SIMD(name) _mm256_##name
+#define SIMD_SI(name) _mm256_##name##_si256
+inline vec_t broadcast_lane(__m128i lane) { return _mm256_broadcastsi128_si256(lane); }
+#else
+using vec_t = __m128i;
+#define SIMD(name) _mm_##name
+#define SIMD_SI(name) _mm_##name##_si128
+inline vec_t broadcast_lane(__m128i lane) { return lane; }
+#endif
+constexpr size_t vec_size = sizeof(vec_t);
+
+// Convert 4 * 6 bits, in the high bits of each 32 bit word of three bytes (as arranged by encode_base64), into base64 characters.
+inline vec_t encode_block(vec_t in)
 {
-  friend class boost::iterator_core_access;
+  // Put the three bytes of each group in a 32 bit word as: b1 b0 b2 b1.
+  in = SIMD(shuffle_epi8)(in, broadcast_lane(_mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10)));
+  // Shift each six bit value into its own byte.
+  vec_t const t0 = SIMD_SI(and)(in, SIMD(set1_epi32)(0x0fc0fc00));
+  vec_t const t1 = SIMD(mulhi_epu16)(t0, SIMD(set1_epi32)(0x04000040));
+  vec_t const t2 = SIMD_SI(and)(in, SIMD(set1_epi32)(0x003f03f0));
+  vec_t const t3 = SIMD(mullo_epi16)(t2, SIMD(set1_epi32)(0x01000010));
+  vec_t const indices = SIMD_SI(or)(t1, t3);
+  // Add the offset of the range that each value belongs to: 0..25 'A', 26..51 'a', 52..61 '0', 62 '+', 63 '/'.
+  vec_t const offset_lut = broadcast_lane(_mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0));
+  vec_t range = SIMD(subs_epu8)(indices, SIMD(set1_epi8)(51));
+  range = SIMD(sub_epi8)(range, SIMD(cmpgt_epi8)(indices, SIMD(set1_epi8)(25)));
+  return SIMD(add_epi8)(indices, SIMD(shuffle_epi8)(offset_lut, range));
+}
 
-  using super_t = escape<convert<Base>, Base>;
+// Convert base64 characters into their six bit values and pack those into three bytes per four characters,
+// at the start of each lane. Returns false if any character isn't one of the 64 of the alphabet.
+inline bool decode_block(vec_t& in)
+{
+  vec_t const mask_2f = SIMD(set1_epi8)(0x2f);
+  vec_t const lut_lo = broadcast_lane(_mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a));
+  vec_t const lut_hi = broadcast_lane(_mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10));
+  vec_t const lut_roll = broadcast_lane(_mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0));
+  vec_t const hi_nibbles = SIMD_SI(and)(SIMD(srli_epi32)(in, 4), mask_2f);
+  vec_t const lo_nibbles = SIMD_SI(and)(in, mask_2f);
+  vec_t const lo = SIMD(shuffle_epi8)(lut_lo, lo_nibbles);
+  vec_t const hi = SIMD(shuffle_epi8)(lut_hi, hi_nibbles);
+  // A character is valid when the bits of its high and low nibble in these tables don't overlap.
+  if (SIMD(movemask_epi8)(SIMD(cmpeq_epi8)(SIMD_SI(and)(lo, hi), SIMD_SI(setzero)())) != static_cast<int>(~uint32_t{0} >> (32 - vec_size)))
+    return false;
+  vec_t const eq_2f = SIMD(cmpeq_epi8)(in, mask_2f);
+  vec_t const roll = SIMD(shuffle_epi8)(lut_roll, SIMD(add_epi8)(eq_2f, hi_nibbles));
+  vec_t const sextets = SIMD(add_epi8)(in, roll);
+  // Merge pairs of six bits into twelve bits, and pairs of those into 24 bits.
+  vec_t const merged_ab_cd = SIMD(maddubs_epi16)(sextets, SIMD(set1_epi32)(0x01400140));
+  vec_t const merged = SIMD(madd_epi16)(merged_ab_cd, SIMD(set1_epi32)(0x00011000));
+  // Put the three bytes of every 32 bit word in big-endian order at the start of the lane.
+  in = SIMD(shuffle_epi8)(merged, broadcast_lane(_mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1)));
+#if defined(__AVX2__)
+  // Move the 12 bytes of the high lane next to those of the low lane.
+  in = _mm256_permutevar8x32_epi32(in, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, -1, -1));
+#endif
+  return true;
+}
+#endif // __AVX2__ || __SSSE3__
 
- public:
-  char fill(char const*& bstart, char const*& bend);
-  wchar_t fill(wchar_t const*& bstart, wchar_t const*& bend);
+// Encode len bytes at in to base64 at out, which must have room for 4 * ((len + 2) / 3) characters.
+void encode_base64(unsigned char const* in, size_t len, char* out)
+{
+  unsigned char const* const end = in + len;
+#if defined(__AVX2__) || defined(__SSSE3__)
+  // Each block consumes 3/4 of vec_size bytes, but loads a whole lane (16 bytes) from the start of the last 12 of them.
+  constexpr size_t block_size = vec_size / 4 * 3;
+  while (end - in >= static_cast<ptrdiff_t>(block_size - 12 + 16))
+  {
+#if defined(__AVX2__)
+    vec_t block = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<__m128i const*>(in))),
+        _mm_loadu_si128(reinterpret_cast<__m128i const*>(in + 12)), 1);
+#else
+    vec_t block = _mm_loadu_si128(reinterpret_cast<__m128i const*>(in));
+#endif
+    SIMD_SI(storeu)(reinterpret_cast<vec_t*>(out), encode_block(block));
+    in += block_size;
+    out += vec_size;
+  }
+#endif
+  for (; end - in >= 3; in += 3)
+  {
+    uint32_t const group = in[0] << 16 | in[1] << 8 | in[2];
+    *out++ = base64_alphabet[group >> 18];
+    *out++ = base64_alphabet[(group >> 12) & 0x3f];
+    *out++ = base64_alphabet[(group >> 6) & 0x3f];
+    *out++ = base64_alphabet[group & 0x3f];
+  }
+  if (in != end)
+  {
+    uint32_t const group = in[0] << 16 | (end - in == 2 ? in[1] << 8 : 0);
+    *out++ = base64_alphabet[group >> 18];
+    *out++ = base64_alphabet[(group >> 12) & 0x3f];
+    *out++ = end - in == 2 ? base64_alphabet[(group >> 6) & 0x3f] : '=';
+    *out++ = '=';
+  }
+}
 
-  template<class T>
-  convert(T start) : super_t(Base(static_cast<T>(start))) { }
-  // intel 7.1 doesn't like default copy constructor
-  convert(convert const& rhs) : super_t(rhs.base_reference()) { }
-};
+// Decode the base64 characters [in, end) to out, which must have room for 3 * ((end - in) / 4) bytes.
+// Whitespace is ignored. Returns one past the last byte written.
+char* decode_base64(char const* in, char const* const end, char* out)
+{
+  for (;;)
+  {
+#if defined(__AVX2__) || defined(__SSSE3__)
+    // Each block writes vec_size bytes, of which only the first 3/4 are used. Because the input
+    // contains at least four characters for every three bytes of room, there is room for this
+    // as long as at least 4 * (vec_size / 3 + 1) characters are left.
+    while (end - in >= static_cast<ptrdiff_t>(4 * (vec_size / 3 + 1)))
+    {
+      vec_t block = SIMD_SI(loadu)(reinterpret_cast<vec_t const*>(in));
+      if (!decode_block(block))
+        break;                          // Whitespace, padding or an invalid character: continue below.
+      SIMD_SI(storeu)(reinterpret_cast<vec_t*>(out), block);
+      in += vec_size;
+      out += vec_size / 4 * 3;
+    }
+#endif
+    // Decode groups of four characters one at a time, until one contained whitespace.
+    bool skipped_whitespace = false;
+    do
+    {
+      if (end - in >= 4)
+      {
+        uint8_t const v0 = base64_decode_table[static_cast<unsigned char>(in[0])];
+        uint8_t const v1 = base64_decode_table[static_cast<unsigned char>(in[1])];
+        uint8_t const v2 = base64_decode_table[static_cast<unsigned char>(in[2])];
+        uint8_t const v3 = base64_decode_table[static_cast<unsigned char>(in[3])];
+        if (AI_LIKELY((v0 | v1 | v2 | v3) < 64))
+        {
+          uint32_t const group = v0 << 18 | v1 << 12 | v2 << 6 | v3;
+          *out++ = group >> 16;
+          *out++ = group >> 8;
+          *out++ = group;
+          in += 4;
+          continue;
+        }
+      }
+      uint32_t group = 0;
+      int count = 0;
+      int padding = 0;
+      while (count < 4 && in != end)
+      {
+        uint8_t value = base64_decode_table[static_cast<unsigned char>(*in++)];
+        if (AI_UNLIKELY(value >= base64_whitespace))
+        {
+          if (value == base64_whitespace)
+          {
+            skipped_whitespace = true;
+            continue;
+          }
+          if (value == base64_invalid)
+            THROW_ALERT("Invalid base64 character [[CHAR]]", AIArgs("[CHAR]", utils::print_using(std::string_view(in - 1, 1), utils::c_escape)));
+          // Padding is only allowed as the last one or two characters of a group.
+          if (count < 2)
+            THROW_ALERT("Unexpected base64 padding");
+          ++padding;
+          value = 0;
+        }
+        else if (AI_UNLIKELY(padding))
+          THROW_ALERT("Unexpected base64 padding");
+        group = group << 6 | value;
+        ++count;
+      }
+      if (count == 0)
+        return out;
+      if (count < 4)
+        THROW_ALERT("Input length is not a multiple of four");
+      *out++ = group >> 16;
+      if (padding < 2)
+        *out++ = group >> 8;
+      if (padding < 1)
+        *out++ = group;
+      if (padding)
+      {
+        // Nothing but whitespace may follow the padding.
+        for (; in != end; ++in)
+          if (base64_decode_table[static_cast<unsigned char>(*in)] != base64_whitespace)
+            THROW_ALERT("Unexpected base64 data after padding");
+        return out;
+      }
+    }
+    while (!skipped_whitespace);
+  }
+}
 
-template<class Base>
-char convert<Base>::fill(char const*& bstart, char const*& bend)
+#ifdef __SSE2__
+// Convert each nibble (0..15) to its hexadecimal digit.
+inline __m128i hex_digits(__m128i nibbles)
 {
-  char current_value = *this->base_reference();
-  if (current_value == '=')
-    current_value = 'A';
-  return current_value;
+  __m128i const letter = _mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9));
+  return _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), _mm_and_si128(letter, _mm_set1_epi8('a' - '0' - 10)));
 }
+#endif
 
-template<class Base>
-wchar_t convert<Base>::fill(wchar_t const*& bstart, wchar_t const*& bend)
+#ifdef __AVX2__
+inline __m256i hex_digits(__m256i nibbles)
 {
-  wchar_t current_value = *this->base_reference();
-  if (current_value == '=')
-    current_value = 'A';
-  return current_value;
+  __m256i const letter = _mm256_cmpgt_epi8(nibbles, _mm256_set1_epi8(9));
+  return _mm256_add_epi8(_mm256_add_epi8(nibbles, _mm256_set1_epi8('0')), _mm256_and_si256(letter, _mm256_set1_epi8('a' - '0' - 10)));
 }
+#endif
 
 char nibble(int val)
 {
@@ -68,32 +263,58 @@ namespace evio {
 // Decode
 void BinaryData::assign_from_base64(std::string_view const& data)
 {
-  if (data.size() % 4 != 0)
-    THROW_FALERT("Input length is not a multiple of four");
-  int padding_len = data.size() - 1 - data.find_last_not_of('=');
-  using it_binary_t = transform_width<binary_from_base64<convert<std::string_view::const_iterator>>, 8, 6>;
-  m_data.assign(it_binary_t(data.begin()), it_binary_t(data.end()));
-  m_data.erase(m_data.end() - padding_len, m_data.end());
+  // Decode directly into m_data, sized for the maximum number of bytes; then shrink it to what was written.
+  m_data.resize(data.size() / 4 * 3);
+  char* end = decode_base64(data.data(), data.data() + data.size(), m_data.data());
+  m_data.resize(end - m_data.data());
 }
 
 // Encode
+char* BinaryData::to_base64(char* buf) const
+{
+  encode_base64(reinterpret_cast<unsigned char const*>(m_data.data()), m_data.size(), buf);
+  return buf + base64_size();
+}
+
 std::string BinaryData::to_base64_string() const
 {
-  using it_base64_t = base64_from_binary<transform_width<data_type::const_iterator, 6, 8>>;
-  std::string base64(it_base64_t(m_data.begin()), it_base64_t(m_data.end()));
-  base64.append(required_padding(m_data.size() % 3), '=');
+  std::string base64(base64_size(), '\0');
+  to_base64(base64.data());
   return base64;
 }
 
 std::string BinaryData::to_hexadecimal_string() const
 {
-  std::string result;
-  result.reserve(2 * m_data.size());
-  for (auto b : m_data)
+  std::string result(2 * m_data.size(), '\0');
+  char const* in = m_data.data();
+  char const* const end = in + m_data.size();
+  char* out = result.data();
+#ifdef __AVX2__
+  for (; end - in >= 32; in += 32, out += 64)
+  {
+    // Reorder the 64 bit quarters as 0, 2, 1, 3, so that unpacking each lane yields the digits of quarters 0, 1 and then 2, 3.
+    __m256i const v = _mm256_permute4x64_epi64(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(in)), 0xd8);
+    __m256i const hi = hex_digits(_mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0f)));
+    __m256i const lo = hex_digits(_mm256_and_si256(v, _mm256_set1_epi8(0x0f)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_unpacklo_epi8(hi, lo));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 32), _mm256_unpackhi_epi8(hi, lo));
+  }
+#endif
+#ifdef __SSE2__
+  for (; end - in >= 16; in += 16, out += 32)
+  {
+    __m128i const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(in));
+    __m128i const hi = hex_digits(_mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0f)));
+    __m128i const lo = hex_digits(_mm_and_si128(v, _mm_set1_epi8(0x0f)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi8(hi, lo));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16), _mm_unpackhi_epi8(hi, lo));
+  }
+#endif
+  for (; in != end; ++in)
   {
-    int val = /*std::to_integer<int>*/(b);
-    result += nibble(val >> 4);
-    result += nibble(val & 0xf);
+    int val = static_cast<unsigned char>(*in);
+    *out++ = nibble(val >> 4);
+    *out++ = nibble(val & 0xf);
   }
   return result;
 }
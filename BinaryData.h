@@ -22,14 +22,20 @@ class BinaryData
   BinaryData() = default;
 
   void assign_from_binary(std::string_view const& data) { m_data.assign(data.begin(), data.end()); }
+  // Decode base64 (RFC4648). Whitespace (as used to wrap lines) is ignored.
   void assign_from_base64(std::string_view const& data);
 
+  // The number of characters written by to_base64.
+  size_t base64_size() const { return (m_data.size() + 2) / 3 * 4; }
+  // Write the base64 encoding to buf, which must have room for base64_size() characters. Returns the end.
+  char* to_base64(char* buf) const;
   std::string to_base64_string() const;
   std::string to_hexadecimal_string() const;
   std::string to_xml_escaped_string() const;
   std::string to_c_escaped_string() const;
 
   std::string to_string() const { return {m_data.begin(), m_data.end()}; }
+  std::string_view binary_view() const { return {m_data.data(), m_data.size()}; }
 
   void print_on(std::ostream& os) const;        // Print as escaped string with quotes around it.
 
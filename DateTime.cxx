@@ -2,41 +2,60 @@
 #include "DateTime.h"
 #include "utils/AIAlert.h"
 #include "debug.h"
-#include <cctype>       // std::isdigit
-#include <sstream>
-#include <iomanip>
-#include <time.h>       // gmtime_r, timegm
+#include <cstdint>
+#include <ostream>
 
 namespace {
 
-// The output for posix time 67767976233532799.
-// Larger values even put a minus sign in front of this, but sizeof
-// includes the terminating zero, so that has been taken into account ;).
-constexpr size_t max_iso8601_string_len = sizeof("2147483647-12-31T23:59:59Z");
+// The number of days since 1970-01-01 of the given date of the proleptic Gregorian calendar.
+// See http://howardhinnant.github.io/date_algorithms.html
+constexpr int64_t days_from_civil(int64_t year, unsigned month, unsigned day)
+{
+  year -= month <= 2;
+  int64_t const era = (year >= 0 ? year : year - 399) / 400;
+  unsigned const year_of_era = static_cast<unsigned>(year - era * 400);                       // [0, 399]
+  unsigned const day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;   // [0, 365]
+  unsigned const day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;     // [0, 146096]
+  return era * 146097 + static_cast<int64_t>(day_of_era) - 719468;
+}
 
-// Convert a series of digits into an int.
-int to_int(std::string_view::const_iterator& start, std::string_view::const_iterator end)
+// The inverse of days_from_civil.
+constexpr void civil_from_days(int64_t days, int64_t& year, unsigned& month, unsigned& day)
 {
-  int result = 0;
-  while (start != end && std::isdigit(*start))
-  {
-    result *= 10;
-    result += *start++ - '0';
-  }
-  return result;
+  days += 719468;
+  int64_t const era = (days >= 0 ? days : days - 146096) / 146097;
+  unsigned const day_of_era = static_cast<unsigned>(days - era * 146097);
+  unsigned const year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+  unsigned const day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+  unsigned const mp = (5 * day_of_year + 2) / 153;                                              // [0, 11], starting at March.
+  day = day_of_year - (153 * mp + 2) / 5 + 1;
+  month = mp < 10 ? mp + 3 : mp - 9;
+  year = static_cast<int64_t>(year_of_era) + era * 400 + (month <= 2);
+}
+
+static_assert(days_from_civil(1970, 1, 1) == 0 && days_from_civil(2000, 3, 1) == 11017, "days_from_civil is broken");
+
+constexpr unsigned days_in_month(int64_t year, unsigned month)
+{
+  if (month == 2)
+    return (year % 4 == 0 && (year % 100 != 0 || year % 400 == 0)) ? 29 : 28;
+  return 30 + ((month + (month >> 3)) & 1);
+}
+
+// Parse two digits at p. Clears valid if they aren't digits.
+inline unsigned two_digits(char const* p, bool& valid)
+{
+  unsigned const d0 = static_cast<unsigned char>(p[0]) - '0';
+  unsigned const d1 = static_cast<unsigned char>(p[1]) - '0';
+  valid &= (d0 < 10) & (d1 < 10);
+  return 10 * d0 + d1;
 }
 
-int next_two_digits(std::string_view::const_iterator& start, std::string_view::const_iterator end, char c)
+inline char* write_two_digits(char* p, unsigned value)
 {
-  if (start == end || !isdigit(*start))
-    return -1;
-  int result = 10 * (*start++ - '0');
-  if (start == end || !isdigit(*start))
-    return -1;
-  result += *start++ - '0';
-  if (start == end || *start++ != c)
-    return -1;
-  return result;
+  p[0] = '0' + value / 10;
+  p[1] = '0' + value % 10;
+  return p + 2;
 }
 
 } // namespace
@@ -45,41 +64,95 @@ namespace evio {
 
 void DateTime::assign_from_iso8601_string(std::string_view const& data)
 {
-  struct tm date_time{};
-  auto current_pos = data.begin();
-  date_time.tm_year = to_int(current_pos, data.end()) - 1900;
-  bool parse_error = current_pos == data.begin() || *current_pos != '-';
-  if (!parse_error)
+  // Everything after the year has a fixed format: -MM-DDThh:mm:ssZ
+  constexpr size_t tail_size = 16;
+  constexpr size_t max_year_digits = 9;
+  bool valid = data.size() > tail_size && data.size() <= tail_size + max_year_digits;
+  if (valid)
+  {
+    char const* const year_end = data.data() + data.size() - tail_size;
+    int64_t year = 0;
+    for (char const* p = data.data(); p != year_end; ++p)
+    {
+      unsigned const digit = static_cast<unsigned char>(*p) - '0';
+      valid &= digit < 10;
+      year = 10 * year + digit;
+    }
+    char const* const t = year_end;
+    valid &= (t[0] == '-') & (t[3] == '-') & (t[6] == 'T') & (t[9] == ':') & (t[12] == ':') & (t[15] == 'Z');
+    unsigned const month = two_digits(t + 1, valid);
+    unsigned const day = two_digits(t + 4, valid);
+    unsigned const hour = two_digits(t + 7, valid);
+    unsigned const minute = two_digits(t + 10, valid);
+    unsigned const second = two_digits(t + 13, valid);
+    if (AI_LIKELY(valid))
+    {
+      // A leap second (60) is accepted and, like timegm does, counted as the first second of the next minute.
+      if (month - 1 >= 12 || day - 1 >= days_in_month(year, month) || hour >= 24 || minute >= 60 || second > 60)
+        THROW_FALERTE("ISO8601 date/time \"[DATA]\" is out of range", AIArgs("[DATA]", data));
+      m_posix_time = days_from_civil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+      return;
+    }
+  }
+  THROW_FALERTE("Failed to parse ISO8601 date/time \"[DATA]\"", AIArgs("[DATA]", data));
+}
+
+size_t DateTime::to_iso8601(char* buf) const
+{
+  // Round towards minus infinity, so that the time of day is never negative.
+  int64_t days = m_posix_time / 86400;
+  int64_t seconds = m_posix_time - days * 86400;
+  if (seconds < 0)
+  {
+    --days;
+    seconds += 86400;
+  }
+  int64_t year;
+  unsigned month, day;
+  civil_from_days(days, year, month, day);
+
+  char* p = buf;
+  uint64_t abs_year = year;
+  if (year < 0)
+  {
+    *p++ = '-';
+    abs_year = -abs_year;
+  }
+  // At least four digits.
+  char digits[20];
+  int n = 0;
+  do
   {
-    ++current_pos;      // Skip '-'.
-    parse_error =
-        (date_time.tm_mon  = next_two_digits(current_pos, data.end(), '-')) == -1 ||
-        (date_time.tm_mday = next_two_digits(current_pos, data.end(), 'T')) == -1 ||
-        (date_time.tm_hour = next_two_digits(current_pos, data.end(), ':')) == -1 ||
-        (date_time.tm_min  = next_two_digits(current_pos, data.end(), ':')) == -1 ||
-        (date_time.tm_sec  = next_two_digits(current_pos, data.end(), 'Z')) == -1 ||
-        current_pos != data.end();
-    --date_time.tm_mon; // Runs from 0..11
+    digits[n++] = '0' + abs_year % 10;
+    abs_year /= 10;
   }
-  if (parse_error)
-    THROW_FALERTE("Failed to parse ISO8601 date/time \"[DATA]\"", AIArgs("[DATA]", data));
-  date_time.tm_isdst = 0;       // Zulu time has no DST.
-  m_posix_time = timegm(&date_time);
-  if (m_posix_time == -1)
-    THROW_ALERTE("mktime: could not convert \"[DATETIME]\" to a time_t!", AIArgs("[DATETIME]", std::put_time(&date_time, "%FT%TZ")));
+  while (abs_year || n < 4);
+  while (n)
+    *p++ = digits[--n];
+  *p++ = '-';
+  p = write_two_digits(p, month);
+  *p++ = '-';
+  p = write_two_digits(p, day);
+  *p++ = 'T';
+  p = write_two_digits(p, seconds / 3600);
+  *p++ = ':';
+  p = write_two_digits(p, seconds / 60 % 60);
+  *p++ = ':';
+  p = write_two_digits(p, seconds % 60);
+  *p++ = 'Z';
+  return p - buf;
 }
 
 std::string DateTime::to_iso8601_string() const
 {
-  std::ostringstream buf2;
-  print_on(buf2);
-  return buf2.str();
+  char buf[iso8601_max_size];
+  return { buf, to_iso8601(buf) };
 }
 
 void DateTime::print_on(std::ostream& os) const
 {
-  struct tm date_time_buf;
-  os << std::put_time(gmtime_r(&m_posix_time, &date_time_buf), "%FT%TZ");
+  char buf[iso8601_max_size];
+  os.write(buf, to_iso8601(buf));
 }
 
 } // namespace evio
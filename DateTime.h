@@ -1,7 +1,9 @@
 #pragma once
 
+#include <cstddef>
 #include <ctime>
 #include <string_view>
+#include <string>
 #include <iosfwd>
 
 namespace evio {
@@ -25,8 +27,18 @@ class DateTime
   DateTime() { }
   DateTime(std::time_t posix_time) : m_posix_time(posix_time) { }
 
+  std::time_t posix_time() const { return m_posix_time; }
+
+  // The maximum number of characters written by to_iso8601 (for the most negative time_t).
+  static constexpr size_t iso8601_max_size = sizeof("-292277022657-01-27T08:29:52Z") - 1;
+
+  // Parse YYYY-MM-DDThh:mm:ssZ. The year may have more or less than four digits.
   void assign_from_iso8601_string(std::string_view const& data);
 
+  // Write YYYY-MM-DDThh:mm:ssZ to buf, which must have room for iso8601_max_size characters.
+  // Returns the number of characters written; no terminating zero is written.
+  size_t to_iso8601(char* buf) const;
+
   std::string to_iso8601_string() const;
 
   void print_on(std::ostream& os) const;
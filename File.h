@@ -48,6 +48,9 @@ class File : public InputDevice, public OutputDevice
  private:
   std::string m_filename;       // The name of the opened file.
 
+  // Writes to the fd of the file with splice(2).
+  friend class SpliceSink;
+
   // read(2) can return less bytes then is really available (on disk).
   // Setting this to false causes us to continue reading until EAGAIN.
   bool is_stream_oriented() override { return false; }
@@ -53,6 +53,7 @@ class INotifyDecoder : public protocol::Decoder
  protected:
   // Must return value >= 0 --> this is a protocol::Decoder.
   size_t end_of_msg_finder(char const* new_data, size_t rlen, EndOfMsgFinderResult& result) override;
+  bool has_stateless_end_of_msg_finder() const override { return false; }
   void decode(int& allow_deletion_count, MsgBlock&& msg) override;
 };
 
@@ -105,6 +105,10 @@ void InputDevice::read_from_fd(int& allow_deletion_count, int fd)
 
   for (;;)
   {
+    // Let a sink that bypasses the input buffer handle the fd.
+    if (AI_UNLIKELY(m_sink->read_from_fd_directly(allow_deletion_count, fd)))
+      return;
+
     // Allocate more space in the buffer if needed.
     if (space == 0 &&
         (space = m_ibuffer->dev2buf_contiguous_forced()) == 0)
@@ -152,6 +156,7 @@ void InputDevice::read_from_fd(int& allow_deletion_count, int fd)
     if (rlen == 0)                      // EOF reached ?
     {
       Dout(dc::system|dc::evio, "read(" << fd << ", " << (void*)new_data << ", " << space << ") = 0 (EOF)");
+      end_of_input(allow_deletion_count);
       try
       {
         read_returned_zero(allow_deletion_count);
@@ -353,6 +358,41 @@ void InputDevice::data_received(int& allow_deletion_count, char const* new_data,
   }
 }
 
+void InputDevice::end_of_direct_content(int& allow_deletion_count)
+{
+  DoutEntering(dc::evio, "InputDevice::end_of_direct_content({" << allow_deletion_count << "}) [" << this << ']');
+  // This does the same as the handling of a decoder switch in data_received.
+  Sink* current_decoder = m_sink;
+  while (current_decoder->m_total_len == current_decoder->m_content_length)
+  {
+    current_decoder->end_of_content(allow_deletion_count);
+    current_decoder->switch_protocol_decoder(*current_decoder->m_next_decoder);
+    if (!FileDescriptor::state_t::wat(m_state)->m_flags.is_readable() || m_sink == current_decoder)
+      return;
+    current_decoder = m_sink;
+    current_decoder->initialize_content_length();
+  }
+}
+
+void InputDevice::end_of_input(int& allow_deletion_count)
+{
+  if (m_is_link_buffer || m_sink->m_content_length != Sink::c_undefined)
+    return;
+  DoutEntering(dc::evio, "InputDevice::end_of_input({" << allow_deletion_count << "}) [" << this << ']');
+  if (!m_sink->m_next_decoder)
+  {
+    m_sink->end_of_input(allow_deletion_count);
+    return;
+  }
+  // The content was delimited by the closing of the connection: it ends here.
+  m_sink->m_content_length = m_sink->m_total_len;
+  end_of_direct_content(allow_deletion_count);
+  // Also tell the sink that we switched to, unless the device was closed already.
+  if (FileDescriptor::state_t::wat(m_state)->m_flags.is_readable() &&
+      m_sink->m_content_length == Sink::c_undefined && !m_sink->m_next_decoder)
+    m_sink->end_of_input(allow_deletion_count);
+}
+
 size_t LinkBufferPlus::end_of_msg_finder(char const* UNUSED_ARG(new_data), size_t UNUSED_ARG(rlen), EndOfMsgFinderResult& UNUSED_ARG(result))
 {
   DoutEntering(dc::io, "LinkBufferPlus::end_of_msg_finder");
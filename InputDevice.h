@@ -126,11 +126,20 @@ class InputDevice : public RawInputDevice
   inline void set_sink(LinkBufferPlus* link_buffer);
   // This function is called by Sink::switch_protocol_decoder. Never call it from anywhere else.
   void switch_protocol_decoder(Sink& new_decoder) { m_sink = &new_decoder; }
+  // This function is called by Sink::direct_content_received when m_sink received its content length.
+  void end_of_direct_content(int& allow_deletion_count);
   // Give access to the above function.
   template<typename INPUT_DEVICE>
   friend void OutputDevice::set_source(boost::intrusive_ptr<INPUT_DEVICE> const& ptr, size_t requested_minimum_block_size, size_t buffer_full_watermark, size_t max_alloc);
 
+ protected:
+  // Called by read_from_fd when read(2) returned 0, before calling read_returned_zero.
+  // Ends the content of m_sink if it has a next decoder but no content length, and then
+  // calls end_of_input of the current sink if that has neither.
+  void end_of_input(int& allow_deletion_count);
+
 #ifdef DEBUGDEVICESTATS
+ private:
   // Override base class virtual functions.
   void init_input_device(state_t::wat const& state_w) override;
 #endif
@@ -0,0 +1,338 @@
+#include "sys.h"
+#include "SegmentedDownload.h"
+#include "File.h"
+#include "TLSSocket.h"
+#include "utils/AIAlert.h"
+#include <charconv>
+#include <limits>
+#include "debug.h"
+
+namespace evio {
+
+SegmentedDownload::SegmentedDownload(SocketAddress const& address, std::string const& host, std::string const& request_target,
+    File& file, size_t content_length, bool use_tls) :
+  m_address(address), m_host(host), m_use_tls(use_tls), m_file(file), m_content_length(content_length),
+  m_segment_size(s_default_segment_size), m_number_of_connections(0),
+  m_open_connections(0), m_busy_connections(0), m_failures(0), m_finished(false)
+{
+  // The part of every request that doesn't change.
+  m_request_prefix = "GET ";
+  m_request_prefix += request_target;
+  m_request_prefix += " HTTP/1.1\r\nHost: ";
+  m_request_prefix += host;
+  m_request_prefix += "\r\nAccept-Encoding: identity\r\nRange: bytes=";
+}
+
+void SegmentedDownload::start(int number_of_connections, finished_callback_type finished_callback)
+{
+  DoutEntering(dc::evio, "SegmentedDownload::start(" << number_of_connections << ", ...) [" << this << ']');
+  // The Content-Length of a response must fit in an int (see http::MessageDecoder).
+  ASSERT(0 < m_segment_size && m_segment_size <= static_cast<size_t>(std::numeric_limits<int>::max()));
+  ASSERT(number_of_connections > 0);
+  m_finished_callback = std::move(finished_callback);
+  m_number_of_connections = number_of_connections;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (off_t begin = 0; begin < static_cast<off_t>(m_content_length); begin += m_segment_size)
+      m_unassigned.push_back({begin, std::min(begin + static_cast<off_t>(m_segment_size), static_cast<off_t>(m_content_length))});
+  }
+  if (m_content_length == 0)
+    finish(true);
+  else
+    start_connections();
+}
+
+// Must be called with m_mutex locked.
+bool SegmentedDownload::assign_range(Connection& connection)
+{
+  Range range;
+  if (!m_unassigned.empty())
+  {
+    range = m_unassigned.front();
+    m_unassigned.pop_front();
+  }
+  else
+  {
+    // Take over the tail of the range that is expected to be finished last.
+    Connection* slowest = nullptr;
+    double max_time_left = 0.0;
+    for (auto const& other : m_connections)
+    {
+      if (!other->m_busy || other.get() == &connection)
+        continue;
+      off_t left = other->m_end - other->m_position;
+      double time_left = other->m_rate > 0.0 ? left / other->m_rate : std::numeric_limits<double>::infinity();
+      if (left >= static_cast<off_t>(2 * s_min_split_size) && (!slowest || time_left > max_time_left))
+      {
+        slowest = other.get();
+        max_time_left = time_left;
+      }
+    }
+    if (!slowest)
+      return false;
+    // Split such that both connections are done at the same time if they keep their current rates.
+    double fraction = 0.5;
+    if (slowest->m_rate > 0.0 && connection.m_rate > 0.0)
+      fraction = slowest->m_rate / (slowest->m_rate + connection.m_rate);
+    off_t split_point = slowest->m_position + static_cast<off_t>((slowest->m_end - slowest->m_position) * fraction);
+    if (slowest->m_end - split_point < static_cast<off_t>(s_min_split_size))
+      return false;
+    Dout(dc::evio, "Taking over [" << split_point << ", " << slowest->m_end << ") from connection " << slowest << '.');
+    range = {split_point, slowest->m_end};
+    slowest->m_end = split_point;
+  }
+  connection.m_busy = true;
+  ++m_busy_connections;
+  connection.m_request = range;
+  connection.m_end = range.m_end;
+  connection.m_position = range.m_begin;
+  connection.m_request_time = std::chrono::steady_clock::now();
+  return true;
+}
+
+void SegmentedDownload::start_connections()
+{
+  for (;;)
+  {
+    Connection* connection;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_finished || m_unassigned.empty() || m_open_connections >= m_number_of_connections)
+        return;
+      m_connections.push_back(std::make_unique<Connection>(*this));
+      connection = m_connections.back().get();
+      assign_range(*connection);
+      ++m_open_connections;
+    }
+    if (!connect(*connection))
+    {
+      // No callback will be called for this connection.
+      bool failed;
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        --m_open_connections;
+        connection->m_busy = false;
+        --m_busy_connections;
+        m_unassigned.push_front({connection->m_request.m_begin, connection->m_end});
+        failed = ++m_failures > s_max_failures;
+      }
+      if (failed)
+      {
+        finish(false);
+        return;
+      }
+    }
+  }
+}
+
+bool SegmentedDownload::connect(Connection& connection)
+{
+  DoutEntering(dc::evio, "SegmentedDownload::connect(" << &connection << ") [" << this << ']');
+  if (m_use_tls)
+    connection.m_socket = create<TLSSocket>();
+  else
+    connection.m_socket = create<Socket>();
+  connection.m_socket->set_source(connection.m_output);
+  connection.m_socket->set_protocol_decoder(connection.m_decoder);
+  connection.m_socket->on_connected([this, &connection](int& UNUSED_ARG(allow_deletion_count), bool success){
+      if (!success)
+        connection_closed(connection);
+  });
+  connection.m_socket->on_disconnected([this, &connection](int& UNUSED_ARG(allow_deletion_count), bool UNUSED_ARG(success)){
+      connection_closed(connection);
+  });
+  // The request is sent as soon as the connection is established.
+  connection.write_request();
+  if (m_use_tls)
+    return static_cast<TLSSocket&>(*connection.m_socket).connect(m_address, m_host);
+  return connection.m_socket->connect(m_address);
+}
+
+void SegmentedDownload::Connection::write_request()
+{
+  DoutEntering(dc::evio, "SegmentedDownload::Connection::write_request() [" << this << ']');
+  m_body.start(m_download.m_file, m_request.m_begin);
+  m_decoder.expect_response({});
+  m_output << m_download.m_request_prefix << m_request.m_begin << '-' << (m_request.m_end - 1) << "\r\n\r\n" << std::flush;
+}
+
+// Must be called with m_download.m_mutex locked.
+void SegmentedDownload::Connection::update_rate()
+{
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - m_request_time;
+  if (elapsed.count() > 0.0)
+    m_rate = (m_position - m_request.m_begin) / elapsed.count();
+}
+
+void SegmentedDownload::progress(Connection& connection, int& allow_deletion_count)
+{
+  bool split_point_reached;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!connection.m_busy)
+      return;
+    connection.m_position = connection.m_body.offset();
+    connection.update_rate();
+    // The rest of the requested range is being downloaded by another connection.
+    split_point_reached = connection.m_end < connection.m_request.m_end && connection.m_position >= connection.m_end;
+    if (split_point_reached)
+    {
+      connection.m_busy = false;
+      --m_busy_connections;
+    }
+  }
+  if (split_point_reached)
+  {
+    Dout(dc::evio, "Reached " << connection.m_end << "; closing connection " << &connection << '.');
+    // This calls connection_closed.
+    connection.m_socket->close(allow_deletion_count);
+  }
+}
+
+void SegmentedDownload::range_received(Connection& connection, int& allow_deletion_count)
+{
+  DoutEntering(dc::evio, "SegmentedDownload::range_received(" << &connection << ", {" << allow_deletion_count << "}) [" << this << ']');
+  bool next_request = false;
+  bool done;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!connection.m_busy)
+      return;
+    connection.m_position = connection.m_request.m_end;
+    connection.update_rate();
+    connection.m_busy = false;
+    --m_busy_connections;
+    // If the server is going to close the connection then connection_closed starts a new one (if still needed).
+    if (connection.m_decoder.is_persistent())
+      next_request = assign_range(connection);
+    done = is_done();
+  }
+  if (next_request)
+    connection.write_request();
+  else
+    connection.m_socket->close(allow_deletion_count);
+  if (done)
+    finish(true);
+}
+
+void SegmentedDownload::connection_closed(Connection& connection)
+{
+  DoutEntering(dc::evio, "SegmentedDownload::connection_closed(" << &connection << ") [" << this << ']');
+  bool failed = false;
+  bool done;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_finished)
+      return;
+    --m_open_connections;
+    if (connection.m_busy)
+    {
+      connection.m_busy = false;
+      --m_busy_connections;
+      // Request what is still missing again, over another connection.
+      connection.m_position = connection.m_body.offset();
+      if (connection.m_position < connection.m_end)
+        m_unassigned.push_front({connection.m_position, connection.m_end});
+      failed = ++m_failures > s_max_failures;
+    }
+    done = is_done();
+  }
+  if (failed || done)
+    finish(!failed);
+  else
+    start_connections();
+}
+
+void SegmentedDownload::finish(bool success)
+{
+  DoutEntering(dc::evio, "SegmentedDownload::finish(" << success << ") [" << this << ']');
+  std::vector<boost::intrusive_ptr<Socket>> open_sockets;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_finished)
+      return;
+    m_finished = true;
+    if (!success)
+      for (auto const& connection : m_connections)
+        if (connection->m_socket)
+          open_sockets.push_back(connection->m_socket);
+  }
+  // Abort the connections that are still downloading.
+  for (auto const& socket : open_sockets)
+    socket->close();
+  m_finished_callback(success);
+}
+
+//-----------------------------------------------------------------------------
+// SegmentedDownload::BodySink
+
+void SegmentedDownload::BodySink::decode(int& allow_deletion_count, MsgBlock&& msg)
+{
+  SpliceSink::decode(allow_deletion_count, std::move(msg));
+  m_connection.m_download.progress(m_connection, allow_deletion_count);
+}
+
+bool SegmentedDownload::BodySink::read_from_fd_directly(int& allow_deletion_count, int fd)
+{
+  int const prev_allow_deletion_count = allow_deletion_count;
+  bool handled = SpliceSink::read_from_fd_directly(allow_deletion_count, fd);
+  // Closing the device increments allow_deletion_count.
+  if (allow_deletion_count > prev_allow_deletion_count)
+    return true;
+  m_connection.m_download.progress(m_connection, allow_deletion_count);
+  return handled || allow_deletion_count > prev_allow_deletion_count;
+}
+
+void SegmentedDownload::BodySink::end_of_content(int& allow_deletion_count)
+{
+  m_connection.m_download.range_received(m_connection, allow_deletion_count);
+}
+
+//-----------------------------------------------------------------------------
+// SegmentedDownload::ResponseDecoder
+
+SegmentedDownload::ResponseDecoder::ResponseDecoder(Connection& connection) : ResponseHeadersDecoder({}), m_connection(connection)
+{
+  set_header_block_mode();
+  set_default_decoder(connection.m_body);
+}
+
+void SegmentedDownload::ResponseDecoder::check_headers() const
+{
+  int status_code = get_status_code();
+  if (status_code < 200)
+    return;                             // Interim response.
+  if (status_code != 206)
+    THROW_ALERT("Expected 206 (Partial Content) but received status code [STATUS_CODE]", AIArgs("[STATUS_CODE]", status_code));
+  if (is_chunked() || content_coding() != identity)
+    THROW_ALERT("Range response is encoded");
+  Range request;
+  {
+    std::lock_guard<std::mutex> lock(m_connection.m_download.m_mutex);
+    request = m_connection.m_request;
+  }
+  // Content-Range = "bytes" SP first-byte-pos "-" last-byte-pos "/" ( complete-length / "*" )
+  off_t first = -1;
+  off_t last = -1;
+  protocol::http::HeaderField const* content_range = find_header(protocol::http::hf_content_range);
+  if (content_range && content_range->m_value.substr(0, 6) == "bytes ")
+  {
+    char const* const end = content_range->m_value.data() + content_range->m_value.size();
+    auto result = std::from_chars(content_range->m_value.data() + 6, end, first);
+    if (result.ec == std::errc() && result.ptr != end && *result.ptr == '-')
+      result = std::from_chars(result.ptr + 1, end, last);
+    if (result.ec != std::errc() || result.ptr == end || *result.ptr != '/')
+      first = last = -1;
+  }
+  if (first != request.m_begin || last + 1 != request.m_end || content_length() != last + 1 - first)
+    THROW_ALERT("Expected Content-Range bytes [FIRST]-[LAST] with the same Content-Length",
+        AIArgs("[FIRST]", request.m_begin)("[LAST]", request.m_end - 1));
+}
+
+void SegmentedDownload::ResponseDecoder::decode_failed(int& allow_deletion_count)
+{
+  // Close the whole connection; connection_closed requests the range again over a new one.
+  m_connection.m_socket->close(allow_deletion_count);
+}
+
+} // namespace evio
@@ -0,0 +1,160 @@
+#pragma once
+
+#include "Socket.h"
+#include "SocketAddress.h"
+#include "OutputStream.h"
+#include "SpliceSink.h"
+#include "protocol/http.h"
+#include <boost/intrusive_ptr.hpp>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace evio {
+
+class File;
+
+// Download a single resource with several concurrent "Range:" requests (RFC7233),
+// each over its own connection, writing every part straight into a File at its offset.
+//
+// The resource is cut into segments that are handed out to the connections in
+// order. A connection that finished a segment requests the next one over the
+// same (persistent) connection, so that fast connections download more segments
+// than slow ones. Once all segments were handed out, a connection that becomes
+// idle takes over the tail of the segment that is expected to finish last; the
+// tail is split off at the point where both connections should be done at the
+// same time, given their measured rates. The connection that lost its tail is
+// closed as soon as it reaches that point.
+//
+// Usage:
+//
+//   auto file = evio::create<evio::File>();
+//   file->init(::open("big.iso", O_WRONLY | O_CREAT | O_CLOEXEC, 0644));
+//   evio::SegmentedDownload download(server_address, "example.com", "/big.iso", *file, content_length);
+//   download.start(4, [](bool success){ ... });
+//
+// The content length must be known in advance (for example from the Content-Length
+// of a response to a HEAD request). Every response must be the 206 (Partial Content)
+// of exactly the requested range; anything else is counted as a failure, after
+// which the rest of that range is requested again over a new connection.
+// The download fails after s_max_failures failures.
+//
+// This object must stay alive until the finished callback was called.
+//
+class SegmentedDownload
+{
+ public:
+  static constexpr size_t s_default_segment_size = 8 * 1024 * 1024;
+  static constexpr size_t s_min_split_size = 512 * 1024;        // Don't take over a tail that is smaller than this.
+  static constexpr int s_max_failures = 8;
+
+  using finished_callback_type = std::function<void(bool success)>;
+
+ private:
+  struct Range
+  {
+    off_t m_begin;
+    off_t m_end;                        // One past the last byte.
+  };
+
+  class Connection;
+
+  // Writes the body of a response into the file and reports the progress.
+  class BodySink : public SpliceSink
+  {
+   private:
+    Connection& m_connection;
+
+   public:
+    BodySink(Connection& connection) : m_connection(connection) { }
+
+   protected:
+    void decode(int& allow_deletion_count, MsgBlock&& msg) override;
+    bool read_from_fd_directly(int& allow_deletion_count, int fd) override;
+    void end_of_content(int& allow_deletion_count) override;
+  };
+
+  // Rejects any response that isn't the 206 of the requested range.
+  class ResponseDecoder : public protocol::http::ResponseHeadersDecoder
+  {
+   private:
+    Connection& m_connection;
+
+   public:
+    ResponseDecoder(Connection& connection);
+
+   protected:
+    void check_headers() const override;
+    void decode_failed(int& allow_deletion_count) override;
+  };
+
+  class Connection
+  {
+   public:
+    SegmentedDownload& m_download;
+    OutputStream m_output;
+    BodySink m_body;
+    ResponseDecoder m_decoder;
+    boost::intrusive_ptr<Socket> m_socket;      // Destructed first.
+
+    // Protected by SegmentedDownload::m_mutex.
+    bool m_busy;                        // Set while m_request wasn't completely received.
+    Range m_request;                    // The range that was requested.
+    off_t m_end;                        // One past the last byte that is still needed; less than m_request.m_end after a split.
+    off_t m_position;                   // The number of bytes received so far, plus m_request.m_begin.
+    std::chrono::steady_clock::time_point m_request_time;
+    double m_rate;                      // Bytes per second received by this connection, or zero if unknown.
+
+    Connection(SegmentedDownload& download) :
+      m_download(download), m_body(*this), m_decoder(*this), m_busy(false), m_request{0, 0}, m_end(0), m_position(0), m_rate(0.0) { }
+
+    void write_request();
+    void update_rate();
+  };
+
+  SocketAddress const m_address;
+  std::string const m_host;
+  bool const m_use_tls;
+  File& m_file;
+  size_t const m_content_length;
+  size_t m_segment_size;
+  std::string m_request_prefix;         // Everything of a request up till the first byte position of the Range.
+  finished_callback_type m_finished_callback;
+  int m_number_of_connections;          // The number of connections to use.
+
+  std::mutex m_mutex;                   // Protects the members below and the ranges of each Connection.
+  std::deque<Range> m_unassigned;       // Ranges that aren't requested by any connection.
+  std::vector<std::unique_ptr<Connection>> m_connections;      // Also the closed ones; their sockets might still refer to them.
+  int m_open_connections;
+  int m_busy_connections;
+  int m_failures;
+  bool m_finished;
+
+ public:
+  // Pass use_tls to connect with TLSSocket; host is then also used as Server Name Indication.
+  SegmentedDownload(SocketAddress const& address, std::string const& host, std::string const& request_target,
+      File& file, size_t content_length, bool use_tls = false);
+
+  // The size of the segments that the resource is initially cut into. Must be called before start.
+  void set_segment_size(size_t segment_size) { m_segment_size = segment_size; }
+
+  // Start downloading over number_of_connections connections.
+  // finished_callback is called exactly once, when the whole resource was written to the file or the download failed.
+  void start(int number_of_connections, finished_callback_type finished_callback);
+
+ private:
+  bool assign_range(Connection& connection);
+  void start_connections();
+  bool connect(Connection& connection);
+  void progress(Connection& connection, int& allow_deletion_count);
+  void range_received(Connection& connection, int& allow_deletion_count);
+  void connection_closed(Connection& connection);
+  bool is_done() const { return m_unassigned.empty() && m_busy_connections == 0; }
+  void finish(bool success);
+};
+
+} // namespace evio
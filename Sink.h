@@ -95,8 +95,13 @@ class Sink : public protocol::MessageLengthInterface
   // (Re)initialize the above member variables.
   void initialize(InputDevice* input_device);
 
+  // (Re)initialize a sink that is not installed on the input device but is fed by this sink (see protocol::ForwardingDecoder).
+  void initialize_inner_sink(Sink& inner_sink) const { inner_sink.initialize(m_input_device); }
+
   [[gnu::always_inline]] inline void start_input_device();
   [[gnu::always_inline]] inline void stop_input_device();
+  [[gnu::always_inline]] inline void restart_input_device();
+  [[gnu::always_inline]] inline bool is_input_device_readable() const;
   [[gnu::always_inline]] inline void close_input_device(int& allow_deletion_count);
   friend class OutputDevice;
   [[gnu::always_inline]] inline RefCountReleaser close_input_device();
@@ -129,6 +134,15 @@ class Sink : public protocol::MessageLengthInterface
     switch_protocol_decoder(new_decoder, 8 * StreamBuf::round_up_minimum_block_size(new_decoder.minimum_block_size()), std::numeric_limits<size_t>::max());
   }
 
+  // Called by InputDevice::read_from_fd before it reads from fd into the input buffer.
+  // A sink that moves the data out of fd itself (see SpliceSink) does that here and returns true,
+  // or returns false to let the input device read the fd as usual.
+  virtual bool read_from_fd_directly(int& UNUSED_ARG(allow_deletion_count), int UNUSED_ARG(fd)) { return false; }
+
+  // Called from read_from_fd_directly for every len bytes that were moved out of the fd.
+  // Returns true if the content length was reached; end_of_content was then called and the input device switched to the next decoder.
+  [[gnu::always_inline]] inline bool direct_content_received(int& allow_deletion_count, size_t len);
+
  public:
   // Switch to next_decoder after having received exactly get_content_length() bytes.
   void set_next_decoder(Sink& next_decoder, std::function<int()> get_content_length)
@@ -137,6 +151,13 @@ class Sink : public protocol::MessageLengthInterface
     m_get_content_length = get_content_length;
   }
 
+  // Switch to next_decoder when the input device reaches EOF (the content is delimited by the closing of the connection).
+  void set_next_decoder(Sink& next_decoder)
+  {
+    m_next_decoder = &next_decoder;
+    m_get_content_length = nullptr;
+  }
+
   size_t decoder_rlen(size_t rlen) const
   {
     // Return the number of bytes of rlen that are still part of this decoders content.
@@ -153,9 +174,14 @@ class Sink : public protocol::MessageLengthInterface
   // one must do `result.m_sink_type = decoder_stream_sink` before returning from that function.
   virtual size_t end_of_msg_finder(char const* new_data, size_t rlen, EndOfMsgFinderResult& result) = 0;
 
-  // This is called when content length bytes have been processed (so only when set_next_decoder was used).
+  // This is called when content length bytes have been processed (so only when set_next_decoder was used),
+  // or when EOF was reached while no content length was given (set_next_decoder without get_content_length).
   // The default does nothing.
   virtual void end_of_content(int& UNUSED_ARG(allow_deletion_count)) { }
+
+  // This is called when the input device reached EOF while no content length and no next decoder were set.
+  // The default does nothing.
+  virtual void end_of_input(int& UNUSED_ARG(allow_deletion_count)) { }
 };
 
 } // namespace evio
@@ -167,9 +193,28 @@ namespace evio {
 // decode needs access to these.
 void Sink::start_input_device() { m_input_device->start_input_device(); }
 void Sink::stop_input_device() { m_input_device->stop_input_device(); }
+// Start the input device again, unless it was closed in the meantime.
+void Sink::restart_input_device()
+{
+  FileDescriptor::state_t::wat state_w(m_input_device->m_state);
+  if (state_w->m_flags.is_readable())
+    m_input_device->start_input_device(state_w);
+}
+bool Sink::is_input_device_readable() const { return FileDescriptor::state_t::crat(m_input_device->m_state)->m_flags.is_readable(); }
 void Sink::close_input_device(int& allow_deletion_count) { m_input_device->close_input_device(allow_deletion_count); }
 RefCountReleaser Sink::close_input_device() { return m_input_device->close_input_device(); }
 
+bool Sink::direct_content_received(int& allow_deletion_count, size_t len)
+{
+  m_total_len += len;
+  // We should never receive more than m_content_length.
+  ASSERT(m_total_len <= m_content_length);
+  if (m_total_len != m_content_length)
+    return false;
+  m_input_device->end_of_direct_content(allow_deletion_count);
+  return true;
+}
+
 void Sink::change_specs(size_t minimum_block_size, size_t buffer_full_watermark, size_t max_allocated_block_size) const
 {
   m_input_device->m_ibuffer->change_specs(minimum_block_size, buffer_full_watermark, max_allocated_block_size);
@@ -0,0 +1,148 @@
+#include "sys.h"
+#include "SpliceSink.h"
+#include "File.h"
+#include "utils/AIAlert.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include "debug.h"
+#ifdef CWDEBUG
+#include "utils/debug_ostream_operators.h"
+#endif
+
+namespace evio {
+
+SpliceSink::~SpliceSink()
+{
+  close_pipe();
+}
+
+void SpliceSink::close_pipe()
+{
+  if (m_pipe_fd[0] != -1)
+  {
+    ::close(m_pipe_fd[0]);
+    ::close(m_pipe_fd[1]);
+    m_pipe_fd[0] = m_pipe_fd[1] = -1;
+  }
+}
+
+void SpliceSink::start(File& file, off_t offset)
+{
+  DoutEntering(dc::evio, "SpliceSink::start(" << &file << ", " << offset << ") [" << this << ']');
+  m_file_fd = file.m_fd;
+  m_offset = offset;
+  if (m_pipe_fd[0] == -1)
+  {
+    if (pipe2(m_pipe_fd, O_CLOEXEC | O_NONBLOCK) == -1)
+      THROW_ALERTE("pipe2");
+    // Failing to enlarge the pipe is not an error.
+    fcntl(m_pipe_fd[1], F_SETPIPE_SZ, s_pipe_size);
+    int pipe_size = fcntl(m_pipe_fd[1], F_GETPIPE_SZ);
+    m_pipe_size = pipe_size > 0 ? pipe_size : 65536;
+  }
+}
+
+size_t SpliceSink::end_of_msg_finder(char const* UNUSED_ARG(new_data), size_t rlen, EndOfMsgFinderResult& UNUSED_ARG(result))
+{
+  // Write whatever was received.
+  return rlen;
+}
+
+void SpliceSink::decode(int& allow_deletion_count, MsgBlock&& msg)
+{
+  DoutEntering(dc::decoder, "SpliceSink::decode({" << allow_deletion_count << "}, " << msg << ") [" << this << ']');
+  // Call start() before switching to this sink.
+  ASSERT(m_file_fd != -1);
+  char const* data = msg.get_start();
+  size_t len = msg.get_size();
+  while (len > 0)
+  {
+    ssize_t wlen = ::pwrite(m_file_fd, data, len, m_offset);
+    if (wlen == -1)
+    {
+      if (errno == EINTR)
+        continue;
+      Dout(dc::warning|error_cf, "pwrite(" << m_file_fd << ", ..., " << len << ", " << m_offset << ")");
+      m_input_device->close(allow_deletion_count);
+      return;
+    }
+    data += wlen;
+    len -= wlen;
+    m_offset += wlen;
+  }
+}
+
+bool SpliceSink::splice_to_file(size_t len)
+{
+  // Move everything from the pipe to the file. Like write(2), this blocks for regular files.
+  while (len > 0)
+  {
+    ssize_t wlen = ::splice(m_pipe_fd[0], nullptr, m_file_fd, &m_offset, len, SPLICE_F_MOVE);
+    if (wlen == -1)
+    {
+      if (errno == EINTR)
+        continue;
+      Dout(dc::warning|error_cf, "splice(" << m_pipe_fd[0] << ", nullptr, " << m_file_fd << ", {" << m_offset << "}, " << len << ", SPLICE_F_MOVE)");
+      return false;
+    }
+    len -= wlen;                        // splice updated m_offset.
+  }
+  return true;
+}
+
+bool SpliceSink::read_from_fd_directly(int& allow_deletion_count, int fd)
+{
+  DoutEntering(dc::evio, "SpliceSink::read_from_fd_directly({" << allow_deletion_count << "}, " << fd << ") [" << this << ']');
+  if (m_file_fd == -1)
+    return false;
+  for (;;)
+  {
+    size_t len = m_pipe_size;
+    if (m_content_length != c_undefined)
+      len = std::min(len, m_content_length - m_total_len);
+    ssize_t rlen = ::splice(fd, nullptr, m_pipe_fd[1], nullptr, len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (rlen == -1)
+    {
+      int err = errno;
+      if (err == EINTR)
+        continue;
+      if (err == EAGAIN || err == EWOULDBLOCK)
+        return true;                    // Wait till fd is readable again.
+      Dout(dc::warning|error_cf, "splice(" << fd << ", nullptr, " << m_pipe_fd[1] << ", nullptr, " << len << ", SPLICE_F_MOVE | SPLICE_F_NONBLOCK)");
+      m_input_device->read_error(allow_deletion_count, err);
+      return true;
+    }
+    if (rlen == 0)
+    {
+      // EOF. This is only the end of the content when no content length was given.
+      if (m_content_length == c_undefined && m_next_decoder)
+      {
+        // Switch to the next decoder, as InputDevice::end_of_input does.
+        m_content_length = m_total_len;
+        direct_content_received(allow_deletion_count, 0);
+      }
+      else if (m_content_length == c_undefined)
+        end_of_content(allow_deletion_count);
+      else
+        Dout(dc::warning, "SpliceSink: connection closed after " << m_total_len << " of " << m_content_length << " bytes.");
+      // Let the device handle EOF as if read(2) returned 0 (a Socket closes and calls its disconnected callback).
+      m_input_device->read_returned_zero(allow_deletion_count);
+      return true;
+    }
+    Dout(dc::system|dc::evio, "splice(" << fd << ", nullptr, " << m_pipe_fd[1] << ", nullptr, " << len << ", SPLICE_F_MOVE | SPLICE_F_NONBLOCK) = " << rlen);
+    if (!splice_to_file(rlen))
+    {
+      // The pipe still contains data; don't let the next start() write that to the next file.
+      close_pipe();
+      m_input_device->close(allow_deletion_count);
+      return true;
+    }
+    // Let the input device read what follows the content as usual (unless it was closed).
+    int const prev_allow_deletion_count = allow_deletion_count;
+    if (direct_content_received(allow_deletion_count, rlen))
+      return allow_deletion_count > prev_allow_deletion_count;
+  }
+}
+
+} // namespace evio
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "protocol/Decoder.h"
+#include <sys/types.h>
+
+namespace evio {
+
+class File;
+
+// Sink that writes the content that it receives to a File, starting at a given offset.
+//
+// Content that is already in the input buffer when this sink is switched to is
+// written with pwrite(2). After that the data is moved from the fd of the input
+// device to the file with splice(2) through a pipe, without copying it into the
+// input buffer. Use this as body decoder of an http::MessageDecoder (with a
+// Content-Length) to download straight to disk.
+//
+// When the content length is reached end_of_content is called, which can be
+// overridden to be notified of completion. If no content length is set, the
+// content ends when the connection is closed (and end_of_content is called then).
+//
+// Devices that override read_from_fd (like TLSSocket) can not be spliced from;
+// the data is then written to the file with pwrite(2) as it is received.
+//
+class SpliceSink : public protocol::Decoder
+{
+ public:
+  static constexpr int s_pipe_size = 1024 * 1024;       // Requested size of the pipe.
+
+ private:
+  int m_file_fd;                        // The fd of the file that is written to, or -1.
+  off_t m_offset;                       // The offset in the file where the next byte will be written.
+  int m_pipe_fd[2];                     // The pipe that is used for splicing.
+  size_t m_pipe_size;                   // The actual capacity of the pipe.
+
+ public:
+  SpliceSink() : m_file_fd(-1), m_offset(0), m_pipe_fd{-1, -1}, m_pipe_size(0) { }
+  ~SpliceSink();
+
+  // Write the content to file, starting at offset. The file must be opened for writing.
+  void start(File& file, off_t offset = 0);
+
+  // The offset in the file where the next byte will be written.
+  off_t offset() const { return m_offset; }
+
+ protected:
+  size_t end_of_msg_finder(char const* new_data, size_t rlen, EndOfMsgFinderResult& result) override;
+  void decode(int& allow_deletion_count, MsgBlock&& msg) override;
+  bool read_from_fd_directly(int& allow_deletion_count, int fd) override;
+
+ private:
+  bool splice_to_file(size_t len);
+  void close_pipe();
+};
+
+} // namespace evio
@@ -557,7 +557,8 @@ char* StreamBufProducer::update_put_area(std::streamsize& available)
       // the most sensible value might be block_start - but in that case this comparison will evaluate to false
       // since cur_pptr != block_start. Therefore we might as well initialize m_last_gptr to nullptr in the
       // streambuf constructor.
-      cur_pptr == m_last_gptr.load(std::memory_order_acquire))          // If this happens while m_resetting is false then the buffer is truely empty (gptr == pptr).
+      cur_pptr == m_last_gptr.load(std::memory_order_acquire) &&        // If this happens while m_resetting is false then the buffer is truely empty (gptr == pptr).
+      m_put_area_block_node->unique().is_true())                        // Don't overwrite data that is still referenced by a MsgBlock (see protocol::xmlrpc::LazyString).
   {
     Dout(dc::io, "update_put_area: resetting put area.");
 #ifdef DEBUGEVENTRECORDING
@@ -175,7 +175,8 @@ class MemoryBlock
   size_t get_size() const { return m_block_size; }
 
   // See AIRefCount::unique
-  utils::FuzzyBool unique() const { return std::atomic_load_explicit(&m_count, std::memory_order_relaxed) == 1 ? fuzzy::True : fuzzy::WasFalse; }
+  // This is acquire because the caller overwrites the data when the last MsgBlock, possibly in another thread, was released.
+  utils::FuzzyBool unique() const { return std::atomic_load_explicit(&m_count, std::memory_order_acquire) == 1 ? fuzzy::True : fuzzy::WasFalse; }
 
 #ifdef CWDEBUG
   void print_on(std::ostream& os) const
@@ -205,6 +206,10 @@ static constexpr size_t block_overhead_c = sizeof(MemoryBlock) + malloc_overhead
 // a particular instance is only used by the consumer thread, which means it is
 // effectively single threaded with respect to the whole MemoryBlocksBuffer.
 //
+// A decoder may however keep a MsgBlock (see protocol::xmlrpc::LazyString) or
+// pass it to another thread (see protocol::AsyncDecoder): the buffer does not
+// reuse a MemoryBlock that is still referenced by a MsgBlock.
+//
 class MsgBlock
 {
  private:
@@ -270,6 +275,19 @@ class MsgBlock
 
   void remove_prefix(size_t n) { m_string.remove_prefix(n); }
   void remove_suffix(size_t n) { m_string.remove_suffix(n); }
+
+  // Returns true if this MsgBlock keeps a MemoryBlock alive.
+  bool has_memory_block() const { return m_memory_block; }
+
+  // Return a MsgBlock for the part part of this block, that keeps the same MemoryBlock (if any) alive.
+  MsgBlock slice(std::string_view part) const
+  {
+    // part must point inside this block.
+    ASSERT(part.data() >= get_start() && part.data() + part.size() <= get_end());
+    if (!m_memory_block)
+      return part;
+    return {part.data(), part.size(), m_memory_block};
+  }
 };
 
 #ifdef DEBUGEVENTRECORDING
@@ -1323,6 +1341,7 @@ class OutputBuffer : public Buf2Dev
 
   // Raw binary access (instead of using ostream):
   char* raw_pptr() const { return pptr(); }                             // Get pointer to put area.
+  size_t raw_available() const { return available_contiguous_number_of_bytes(); }      // Contiguous space at raw_pptr().
   // Data must be written to the buffer *before* calling raw_pbump().
   void raw_pbump(int n) { pbump(n); }                                   // Bump pointer `n' bytes.
   size_t raw_sputn(char const* s, size_t n) { return xsputn_a(s, n); }  // Copy `n' bytes from `s' to the buffer.
@@ -223,6 +223,7 @@ void TLSSocket::read_from_fd(int& allow_deletion_count, int fd)
         if (rlen == 0)                      // EOF reached ?
         {
           Dout(dc::notice, "TLS::read returned 0 (EOF)");
+          end_of_input(allow_deletion_count);
           read_returned_zero(allow_deletion_count);
           return;
         }
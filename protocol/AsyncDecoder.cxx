@@ -0,0 +1,107 @@
+#include "sys.h"
+#include "AsyncDecoder.h"
+#include "threadpool/AIThreadPool.h"
+#include "debug.h"
+
+namespace evio {
+namespace protocol {
+
+size_t AsyncDecoder::end_of_msg_finder(char const* new_data, size_t rlen, EndOfMsgFinderResult& result)
+{
+  // Let the inner decoder use the same input device as us.
+  if (AI_UNLIKELY(m_inner_input_device != m_input_device))
+  {
+    // The inner decoder must not pass state from end_of_msg_finder to decode (see AsyncDecoder.h).
+    ASSERT(m_inner_decoder.has_stateless_end_of_msg_finder());
+    initialize_inner_sink(m_inner_decoder);
+    m_inner_input_device = m_input_device;
+  }
+  return m_inner_decoder.end_of_msg_finder(new_data, rlen, result);
+}
+
+void AsyncDecoder::decode(int& allow_deletion_count, MsgBlock&& msg)
+{
+  DoutEntering(dc::decoder, "AsyncDecoder::decode({" << allow_deletion_count << "}, " << msg << ") [" << this << ']');
+  // The message must stay valid after we return.
+  ASSERT(msg.has_memory_block());
+  bool need_drain;
+  {
+    backlog_t::wat backlog_w(m_backlog);
+    backlog_w->m_size += msg.get_size();
+    backlog_w->m_messages.push_back(std::move(msg));
+    need_drain = !backlog_w->m_draining;
+    backlog_w->m_draining = true;
+    // Stop reading while the lock is held, so that drain can't start the device before it was stopped.
+    if (backlog_w->m_size > m_high_watermark && !backlog_w->m_stopped)
+    {
+      Dout(dc::decoder, "Decode backlog is " << backlog_w->m_size << " bytes; stopping input device.");
+      backlog_w->m_stopped = true;
+      stop_input_device();
+    }
+  }
+  if (need_drain && !queue_drain())
+  {
+    // Don't block the thread that reads the device; decode the backlog here instead.
+    Dout(dc::warning, "Thread pool queue " << m_handler << " is full! Decoding in the thread that reads the device.");
+    drain(allow_deletion_count);
+  }
+}
+
+// Returns false if the queue of m_handler is full.
+bool AsyncDecoder::queue_drain()
+{
+  AIThreadPool& thread_pool(AIThreadPool::instance());
+  auto queues_access = thread_pool.queues_read_access();
+  auto& queue = thread_pool.get_queue(queues_access, m_handler);
+  {
+    auto queue_access = queue.producer_access();
+    if (queue_access.length() == queue.capacity())
+      return false;
+    // Keep the device, and therefore its decoders, alive until drain() returns.
+    InputDevice* input_device = m_input_device;
+    input_device->inhibit_deletion();
+    queue_access.move_in([this, input_device](){
+      int allow_deletion_count = 1;     // Balance with the call to inhibit_deletion above.
+      drain(allow_deletion_count);
+      // This might delete the device, and therefore this object.
+      input_device->allow_deletion(allow_deletion_count);
+      return false;
+    });
+  }
+  queue.notify_one();
+  return true;
+}
+
+void AsyncDecoder::drain(int& allow_deletion_count)
+{
+  DoutEntering(dc::decoder, "AsyncDecoder::drain({" << allow_deletion_count << "}) [" << this << ']');
+  for (;;)
+  {
+    MsgBlock msg(nullptr, 0);
+    {
+      backlog_t::wat backlog_w(m_backlog);
+      if (backlog_w->m_messages.empty())
+      {
+        backlog_w->m_draining = false;
+        break;
+      }
+      msg = std::move(backlog_w->m_messages.front());
+      backlog_w->m_messages.pop_front();
+    }
+    size_t const msg_len = msg.get_size();
+    // Messages that were received before the input device was closed are discarded.
+    if (is_input_device_readable())
+      m_inner_decoder.decode(allow_deletion_count, std::move(msg));
+    backlog_t::wat backlog_w(m_backlog);
+    backlog_w->m_size -= msg_len;
+    if (backlog_w->m_stopped && backlog_w->m_size <= m_low_watermark)
+    {
+      Dout(dc::decoder, "Decode backlog is " << backlog_w->m_size << " bytes; restarting input device.");
+      backlog_w->m_stopped = false;
+      restart_input_device();
+    }
+  }
+}
+
+} // namespace protocol
+} // namespace evio
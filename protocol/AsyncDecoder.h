@@ -0,0 +1,90 @@
+#pragma once
+
+#include "Decoder.h"
+#include "evio/StreamBuf.h"
+#include "threadpool/AIQueueHandle.h"
+#include "threadsafe/aithreadsafe.h"
+#include <deque>
+#include <mutex>
+
+namespace evio {
+namespace protocol {
+
+// A Decoder that decodes in a different thread pool queue than the one that reads the device.
+//
+// Normally decode runs inside read_from_fd, so that a CPU heavy decoder stops the
+// device from being read until it returns. An AsyncDecoder passes the messages found by
+// the end_of_msg_finder of the inner decoder to the decode of that inner decoder in a
+// task on the thread pool queue handler, while the input device continues reading.
+//
+// There is at most one such task per AsyncDecoder, which decodes all messages that
+// are queued, in the order in which they were received. The MsgBlocks keep their part
+// of the input buffer alive until they are decoded, so nothing is copied.
+//
+// When the total size of the queued messages exceeds high_watermark the input device
+// is stopped. It is started again once that size dropped to low_watermark or less.
+//
+// The end_of_msg_finder of the inner decoder is called from the thread that reads the device,
+// while its decode is called at the same time from a thread of handler for earlier messages.
+// Therefore the inner decoder must not pass state from end_of_msg_finder to decode, which is
+// asserted with has_stateless_end_of_msg_finder(). For example LengthPrefixDecoder, BatchDecoder
+// and http::MessageDecoder do pass state and can not be wrapped. The newline finder of Decoder
+// and the '>' finder of UTF8_SAX_Decoder (and therefore xmlrpc::Decoder) have no state.
+//
+// Usage, for a device that receives a stream of XML-RPC documents:
+//
+//   MyResponse m_response;                      // For example derived from xmlrpc::SingleStructResponse.
+//   xmlrpc::Decoder m_xml_decoder{m_response};
+//   AsyncDecoder m_decoder{m_xml_decoder, low_priority_handler};
+//   ...
+//   device->set_protocol_decoder(m_decoder);
+//
+// The inner decoder must not switch to another decoder. Neither does AsyncDecoder support
+// set_next_decoder. While messages are queued the device is kept alive, the decoders must
+// therefore be members of the device (or otherwise outlive it).
+//
+// If the queue of handler is full then the queued messages are decoded by the thread that
+// reads the device, rather than blocking that thread until there is room in the queue.
+//
+class AsyncDecoder : public Decoder
+{
+ private:
+  struct Backlog
+  {
+    std::deque<MsgBlock> m_messages;    // The messages that still have to be decoded.
+    size_t m_size = 0;                  // The total size of m_messages and the message that is being decoded.
+    bool m_draining = false;            // Set while a task that decodes m_messages is queued or running.
+    bool m_stopped = false;             // Set when the input device was stopped because m_size exceeded the high watermark.
+  };
+  using backlog_t = aithreadsafe::Wrapper<Backlog, aithreadsafe::policy::Primitive<std::mutex>>;
+
+  Decoder& m_inner_decoder;
+  AIQueueHandle const m_handler;        // The thread pool queue that decodes.
+  size_t const m_high_watermark;
+  size_t const m_low_watermark;
+  InputDevice* m_inner_input_device;    // The input device that m_inner_decoder was initialized with.
+  backlog_t m_backlog;
+
+ public:
+  AsyncDecoder(Decoder& inner_decoder, AIQueueHandle handler, size_t high_watermark = 1024 * 1024, size_t low_watermark = 256 * 1024) :
+    m_inner_decoder(inner_decoder), m_handler(handler), m_high_watermark(high_watermark), m_low_watermark(low_watermark),
+    m_inner_input_device(nullptr)
+  {
+    ASSERT(low_watermark <= high_watermark);
+  }
+
+  // The messages of the inner decoder determine what is a good buffer size.
+  size_t average_message_length() const override { return m_inner_decoder.average_message_length(); }
+
+ protected:
+  size_t end_of_msg_finder(char const* new_data, size_t rlen, EndOfMsgFinderResult& result) override;
+  bool has_stateless_end_of_msg_finder() const override { return false; }
+  void decode(int& allow_deletion_count, MsgBlock&& msg) override;
+
+ private:
+  bool queue_drain();
+  void drain(int& allow_deletion_count);
+};
+
+} // namespace protocol
+} // namespace evio
@@ -0,0 +1,64 @@
+#include "sys.h"
+#include "BatchDecoder.h"
+#include "debug.h"
+
+namespace evio {
+namespace protocol {
+
+size_t BatchDecoder::end_of_msg_finder(char const* new_data, size_t rlen, EndOfMsgFinderResult& UNUSED_ARG(result))
+{
+  DoutEntering(dc::endofmsg, "BatchDecoder::end_of_msg_finder(..., " << rlen << ")");
+  m_message_ends.clear();
+  find_message_ends(new_data, rlen, m_message_ends);
+  // Return everything up to the end of the last message, so that decode is called once for all of them.
+  return m_message_ends.empty() ? 0 : m_message_ends.back();
+}
+
+void BatchDecoder::find_message_ends(char const* new_data, size_t rlen, std::vector<size_t>& message_ends)
+{
+  char const* const end = new_data + rlen;
+  for (char const* ptr = new_data; ptr < end;)
+  {
+    char const* newline = static_cast<char const*>(std::memchr(ptr, '\n', end - ptr));
+    if (!newline)
+      break;
+    ptr = newline + 1;
+    message_ends.push_back(ptr - new_data);
+  }
+}
+
+void BatchDecoder::decode(int& allow_deletion_count, MsgBlock&& msg)
+{
+  DoutEntering(dc::decoder, "BatchDecoder::decode({" << allow_deletion_count << "}, " << msg << ") [" << this << ']');
+  // The first message might have started before new_data of the last call to end_of_msg_finder.
+  size_t const offset = msg.get_size() - m_message_ends.back();
+  if (offset > 0)
+    for (size_t& message_end : m_message_ends)
+      message_end += offset;
+  decode_batch(allow_deletion_count, msg, m_message_ends);
+}
+
+void BatchDecoder::decode_batch(int& allow_deletion_count, MsgBlock const& block, std::vector<size_t> const& message_ends)
+{
+  // Closing the input device increments allow_deletion_count (see InputDevice::read_from_fd).
+  // Test that instead of is_input_device_readable(), which would take the state lock for every message.
+  int const prev_allow_deletion_count = allow_deletion_count;
+  size_t begin = 0;
+  for (size_t end : message_ends)
+  {
+    decode_message(allow_deletion_count, block.slice({block.get_start() + begin, end - begin}));
+    // Stop when the input device was closed.
+    if (AI_UNLIKELY(allow_deletion_count > prev_allow_deletion_count))
+      break;
+    begin = end;
+  }
+}
+
+void BatchDecoder::decode_message(int& UNUSED_ARG(allow_deletion_count), MsgBlock&& UNUSED_ARG(msg))
+{
+  // Override decode_message or decode_batch in the derived class.
+  ASSERT(false);
+}
+
+} // namespace protocol
+} // namespace evio
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Decoder.h"
+#include <vector>
+
+namespace evio {
+namespace protocol {
+
+// A Decoder that receives all complete messages of one read at once.
+//
+// InputDevice::data_received calls end_of_msg_finder and decode once per message.
+// For small messages that per-message overhead (two virtual calls, a MsgBlock with
+// an atomic add_reference/release of its MemoryBlock and the bookkeeping of the input
+// buffer) can be larger than the decoding itself. A BatchDecoder instead finds the
+// ends of all messages in the received data in one scan (find_message_ends), and
+// receives them in a single MsgBlock (decode_batch).
+//
+// The default decode_batch passes each message to decode_message, as a slice of
+// that MsgBlock; override decode_batch to avoid that too.
+//
+// Since all messages of a batch are removed from the input buffer at once, a
+// BatchDecoder must not switch to another decoder.
+//
+class BatchDecoder : public Decoder
+{
+ private:
+  std::vector<size_t> m_message_ends;   // The ends of the messages found by the last call to end_of_msg_finder.
+
+ protected:
+  size_t end_of_msg_finder(char const* new_data, size_t rlen, EndOfMsgFinderResult& result) final;
+  // end_of_msg_finder fills m_message_ends, which decode uses.
+  bool has_stateless_end_of_msg_finder() const final { return false; }
+  void decode(int& allow_deletion_count, MsgBlock&& msg) final;
+
+  // Append the offset, relative to new_data, one past the end of every complete message in the rlen bytes at new_data
+  // to message_ends. Note that in order to detect messages that cross the boundary of two calls, internal state might be needed.
+  // The default finds newlines, like Decoder::end_of_msg_finder.
+  virtual void find_message_ends(char const* new_data, size_t rlen, std::vector<size_t>& message_ends);
+
+  // Called with one or more complete messages in block. message_ends contains the offset one past the end of
+  // each message relative to the start of block; the last one is the size of block.
+  virtual void decode_batch(int& allow_deletion_count, MsgBlock const& block, std::vector<size_t> const& message_ends);
+
+  // Called by the default decode_batch for every message.
+  virtual void decode_message(int& allow_deletion_count, MsgBlock&& msg);
+};
+
+} // namespace protocol
+} // namespace evio
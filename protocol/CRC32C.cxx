@@ -0,0 +1,98 @@
+#include "sys.h"
+#include "CRC32C.h"
+#include <array>
+#include <cstring>
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+#include "debug.h"
+
+namespace evio::protocol {
+
+namespace {
+
+// The reflected Castagnoli polynomial.
+constexpr uint32_t polynomial = 0x82f63b78;
+
+constexpr std::array<uint32_t, 256> make_table()
+{
+  std::array<uint32_t, 256> table{};
+  for (uint32_t i = 0; i < 256; ++i)
+  {
+    uint32_t crc = i;
+    for (int bit = 0; bit < 8; ++bit)
+      crc = (crc >> 1) ^ ((crc & 1) ? polynomial : 0);
+    table[i] = crc;
+  }
+  return table;
+}
+
+constexpr std::array<uint32_t, 256> table = make_table();
+
+uint32_t crc32c_software(unsigned char const* data, size_t len, uint32_t crc)
+{
+  for (size_t i = 0; i < len; ++i)
+    crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+uint32_t crc32c_hardware(unsigned char const* data, size_t len, uint32_t crc)
+{
+  uint64_t crc64 = crc;
+  for (; len >= 8; data += 8, len -= 8)
+  {
+    uint64_t word;
+    std::memcpy(&word, data, 8);
+    crc64 = _mm_crc32_u64(crc64, word);
+  }
+  crc = crc64;
+  for (; len > 0; ++data, --len)
+    crc = _mm_crc32_u8(crc, *data);
+  return crc;
+}
+
+bool have_hardware_crc32c()
+{
+  // This might be called from the constructor of a global object.
+  static bool const supported = (__builtin_cpu_init(), __builtin_cpu_supports("sse4.2"));
+  return supported;
+}
+#elif defined(__ARM_FEATURE_CRC32)
+uint32_t crc32c_hardware(unsigned char const* data, size_t len, uint32_t crc)
+{
+  for (; len >= 8; data += 8, len -= 8)
+  {
+    uint64_t word;
+    std::memcpy(&word, data, 8);
+    crc = __crc32cd(crc, word);
+  }
+  for (; len > 0; ++data, --len)
+    crc = __crc32cb(crc, *data);
+  return crc;
+}
+
+constexpr bool have_hardware_crc32c() { return true; }
+#else
+uint32_t crc32c_hardware(unsigned char const* data, size_t len, uint32_t crc)
+{
+  return crc32c_software(data, len, crc);
+}
+
+constexpr bool have_hardware_crc32c() { return false; }
+#endif
+
+} // namespace
+
+uint32_t crc32c(char const* data, size_t len, uint32_t crc)
+{
+  unsigned char const* ptr = reinterpret_cast<unsigned char const*>(data);
+  crc = ~crc;
+  crc = have_hardware_crc32c() ? crc32c_hardware(ptr, len, crc) : crc32c_software(ptr, len, crc);
+  return ~crc;
+}
+
+} // namespace evio::protocol
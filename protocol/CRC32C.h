@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace evio::protocol {
+
+// Returns the CRC32C (Castagnoli, as used by iSCSI and SCTP) of the len bytes at data.
+// Pass the previous result as crc to continue a CRC over more data.
+//
+// Uses the crc32 instruction of SSE 4.2 (x86-64) or ARMv8 when available.
+uint32_t crc32c(char const* data, size_t len, uint32_t crc = 0);
+
+} // namespace evio::protocol
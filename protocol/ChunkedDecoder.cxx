@@ -0,0 +1,121 @@
+#include "sys.h"
+#include "ChunkedDecoder.h"
+#include <charconv>
+#include <cstring>
+#ifdef CWDEBUG
+#include "utils/debug_ostream_operators.h"
+#endif
+
+namespace evio {
+namespace protocol {
+namespace http {
+
+void ChunkedDecoder::start(Decoder& body_decoder, Sink& decoder_after_body)
+{
+  DoutEntering(dc::decoder, "http::ChunkedDecoder::start(" << &body_decoder << ", " << &decoder_after_body << ") [" << this << ']');
+  set_inner_decoder(body_decoder);
+  m_decoder_after_body = &decoder_after_body;
+  m_state = chunk_size_line;
+  m_chunk_remaining = 0;
+  m_trailers.clear();
+}
+
+size_t ChunkedDecoder::end_of_msg_finder(char const* new_data, size_t rlen, EndOfMsgFinderResult& UNUSED_ARG(result))
+{
+  DoutEntering(dc::endofmsg, "http::ChunkedDecoder::end_of_msg_finder(..., " << rlen << ")");
+  // Pass chunk-data on as soon as it is received, even if that is only part of the chunk.
+  if (m_state == chunk_data)
+    return std::min(rlen, m_chunk_remaining);
+  char const* eol = static_cast<char const*>(std::memchr(new_data, '\n', rlen));
+  return eol ? eol - new_data + 1 : 0;
+}
+
+void ChunkedDecoder::decode(int& allow_deletion_count, evio::MsgBlock&& msg)
+{
+  DoutEntering(dc::decoder, "http::ChunkedDecoder::decode({" << allow_deletion_count << "}, " << msg << ") [" << this << ']');
+  try
+  {
+    switch (m_state)
+    {
+      case chunk_size_line:
+        decode_chunk_size_line(msg);
+        m_state = m_chunk_remaining > 0 ? chunk_data : trailer_line;
+        break;
+      case chunk_data:
+        m_chunk_remaining -= msg.get_size();
+        if (m_chunk_remaining == 0)
+          m_state = chunk_data_crlf;
+        forward(allow_deletion_count, std::move(msg));
+        break;
+      case chunk_data_crlf:
+        if (msg.view() != "\r\n")
+          THROW_ALERT("Expected CRLF after chunk-data, got [[LINE]]", AIArgs("[LINE]", msg.view()));
+        m_state = chunk_size_line;
+        break;
+      case trailer_line:
+        if (msg.view() != "\r\n")
+        {
+          decode_trailer_line(std::move(msg));
+          break;
+        }
+        Dout(dc::decoder, "Received last empty line of chunked-body.");
+        discard_partial_message();
+        m_state = chunk_size_line;
+        m_inner_decoder->end_of_content(allow_deletion_count);
+        switch_protocol_decoder(*m_decoder_after_body);
+        break;
+    }
+  }
+  catch (AIAlert::Error const& error)
+  {
+    Dout(dc::warning, error << " caught in ChunkedDecoder.cxx");
+    close_input_device(allow_deletion_count);
+  }
+}
+
+void ChunkedDecoder::decode_chunk_size_line(evio::MsgBlock const& msg)
+{
+  // The new-line is already guaranteed by end_of_msg_finder.
+  if (msg.get_size() < 3 || msg.get_end()[-2] != '\r')
+    THROW_ALERT("Ill-formed chunk-size line [[LINE]]", AIArgs("[LINE]", msg.view()));
+  char const* const eol = msg.get_end() - 2;
+  auto result = std::from_chars(msg.get_start(), eol, m_chunk_remaining, 16);
+  if (result.ec != std::errc() ||
+      // What follows the chunk-size must be a chunk-ext (possibly preceded by BWS), or nothing.
+      (result.ptr != eol && *result.ptr != ';' && *result.ptr != ' ' && *result.ptr != '\t'))
+  {
+    m_chunk_remaining = 0;
+    THROW_ALERT("Invalid chunk-size line [[LINE]]", AIArgs("[LINE]", msg.view()));
+  }
+  Dout(dc::decoder, "chunk-size = " << m_chunk_remaining);
+}
+
+void ChunkedDecoder::decode_trailer_line(evio::MsgBlock&& msg)
+{
+  DoutEntering(dc::decoder, "http::ChunkedDecoder::decode_trailer_line(" << msg << ")");
+  char const* colon = static_cast<char const*>(std::memchr(msg.get_start(), ':', msg.get_size()));
+  if (!colon || colon == msg.get_start() || msg.get_end()[-2] != '\r')
+    THROW_ALERT("Ill-formed trailer field [[LINE]]", AIArgs("[LINE]", msg.view()));
+  evio::MsgBlock field(msg);
+  field.remove_suffix(msg.get_end() - colon);
+  msg.remove_prefix(colon + 1 - msg.get_start());
+  int count = 0;
+  for (char const* ptr = msg.get_start(); ptr != msg.get_end(); ++ptr)
+    if (*ptr == ' ' || *ptr == '\t')
+      ++count;
+    else
+      break;
+  msg.remove_prefix(count);                     // Remove leading OWS.
+  count = 2;
+  for (char const* ptr = msg.get_end() - count; --ptr >= msg.get_start();)
+    if (*ptr == ' ' || *ptr == '\t')
+      ++count;
+    else
+      break;
+  msg.remove_suffix(count);                     // Remove trailing OWS CR LF
+  m_trailers.emplace_back(std::move(field), std::move(msg));
+}
+
+} // namespace http
+} // namespace protocol
+} // namespace evio
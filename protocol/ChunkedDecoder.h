@@ -0,0 +1,77 @@
+#pragma once
+
+#include "ForwardingDecoder.h"
+#include <utility>
+#include <vector>
+
+namespace evio {
+namespace protocol {
+namespace http {
+
+// Decoder for a message body with "Transfer-Encoding: chunked" (RFC7230, section 4.1).
+//
+// chunked-body   = *chunk
+//                  last-chunk
+//                  trailer-part
+//                  CRLF
+//
+// chunk          = chunk-size [ chunk-ext ] CRLF
+//                  chunk-data CRLF
+// chunk-size     = 1*HEXDIG
+// last-chunk     = 1*("0") [ chunk-ext ] CRLF
+//
+// trailer-part   = *( header-field CRLF )
+//
+// The chunk framing is stripped and the chunk-data is passed on to the
+// body decoder (see ForwardingDecoder). Chunk extensions are ignored.
+// The trailer fields are stored and can be retrieved with trailers()
+// from the end_of_content of the body decoder until clear_trailers() is called.
+//
+// Once the whole chunked-body is received, end_of_content of the body decoder
+// is called and the input device switches to the decoder passed to start().
+//
+class ChunkedDecoder : public ForwardingDecoder
+{
+ public:
+  // The states that we can be in.
+  enum state_st {
+    chunk_size_line,
+    chunk_data,
+    chunk_data_crlf,
+    trailer_line
+  };
+
+ private:
+  state_st m_state;
+  size_t m_chunk_remaining;                     // The number of bytes of chunk-data that still have to be received.
+  Sink* m_decoder_after_body;                   // The decoder to switch to after the last trailer line.
+  std::vector<std::pair<evio::MsgBlock, evio::MsgBlock>> m_trailers;   // Field, Value pairs.
+
+ public:
+  ChunkedDecoder() : m_state(chunk_size_line), m_chunk_remaining(0), m_decoder_after_body(nullptr) { }
+
+  // Prepare for decoding a new chunked-body that must be passed to body_decoder.
+  // Afterwards switch to decoder_after_body.
+  //
+  // The caller must call initialize_inner_sink(body_decoder) and then switch to this decoder.
+  void start(Decoder& body_decoder, Sink& decoder_after_body);
+
+  // Accessor for the trailer fields received after the last chunk.
+  std::vector<std::pair<evio::MsgBlock, evio::MsgBlock>> const& trailers() const { return m_trailers; }
+
+  // Release the trailer fields (and with them the buffer memory that they refer to).
+  void clear_trailers() { m_trailers.clear(); }
+
+ protected:
+  size_t end_of_msg_finder(char const* new_data, size_t rlen, EndOfMsgFinderResult& result) override;
+  bool has_stateless_end_of_msg_finder() const override { return false; }
+  void decode(int& allow_deletion_count, evio::MsgBlock&& msg) override;
+
+ private:
+  void decode_chunk_size_line(evio::MsgBlock const& msg);
+  void decode_trailer_line(evio::MsgBlock&& msg);
+};
+
+} // namespace http
+} // namespace protocol
+} // namespace evio
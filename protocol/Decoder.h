@@ -41,6 +41,12 @@ class Decoder : public Sink
   friend class InputDevice;
   // This should return true iff it called set_next_decoder.
   virtual void decode(int& allow_deletion_count, MsgBlock&& msg) = 0;
+
+  // Should return true if end_of_msg_finder passes no state to decode (for example the size of
+  // a header that it parsed), so that decode can run concurrently with end_of_msg_finder for
+  // the following messages (see AsyncDecoder). The default end_of_msg_finder has no state;
+  // a derived class whose end_of_msg_finder does must override this to return false.
+  virtual bool has_stateless_end_of_msg_finder() const { return true; }
 };
 
 } // namespace protocol
@@ -0,0 +1,64 @@
+#include "sys.h"
+#include "DeflateOutputStream.h"
+#include "utils/AIAlert.h"
+#include "debug.h"
+
+namespace evio {
+namespace protocol {
+
+DeflateStreamBuf::DeflateStreamBuf(std::streambuf* target, bool gzip, int level) : m_target(target), m_zstream{}, m_finished(false)
+{
+  // 15 is the maximum window size; adding 16 writes a gzip header and trailer instead of a zlib wrapper.
+  int ret = deflateInit2(&m_zstream, level, Z_DEFLATED, gzip ? 15 + 16 : 15, 8, Z_DEFAULT_STRATEGY);
+  if (ret != Z_OK)
+    THROW_ALERT("deflateInit2 failed: [ERROR]", AIArgs("[ERROR]", zError(ret)));
+  setp(m_input_buffer, m_input_buffer + s_input_buffer_size);
+}
+
+bool DeflateStreamBuf::deflate(int flush)
+{
+  m_zstream.next_in = reinterpret_cast<Bytef*>(pbase());
+  m_zstream.avail_in = pptr() - pbase();
+  char output_buffer[s_input_buffer_size];
+  int ret;
+  do
+  {
+    m_zstream.next_out = reinterpret_cast<Bytef*>(output_buffer);
+    m_zstream.avail_out = sizeof(output_buffer);
+    ret = ::deflate(&m_zstream, flush);
+    // Z_BUF_ERROR only means that no progress was possible.
+    ASSERT(ret != Z_STREAM_ERROR);
+    std::streamsize produced = sizeof(output_buffer) - m_zstream.avail_out;
+    if (produced > 0 && m_target->sputn(output_buffer, produced) != produced)
+      return false;
+  }
+  while (m_zstream.avail_out == 0 || (flush == Z_FINISH && ret != Z_STREAM_END));
+  setp(m_input_buffer, m_input_buffer + s_input_buffer_size);
+  return true;
+}
+
+DeflateStreamBuf::int_type DeflateStreamBuf::overflow(int_type c)
+{
+  // Writing after finish() is not allowed.
+  ASSERT(!m_finished);
+  if (!deflate(Z_NO_FLUSH))
+    return traits_type::eof();
+  if (!traits_type::eq_int_type(c, traits_type::eof()))
+  {
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+  }
+  return traits_type::not_eof(c);
+}
+
+bool DeflateStreamBuf::finish()
+{
+  DoutEntering(dc::evio, "DeflateStreamBuf::finish() [" << this << ']');
+  if (m_finished)
+    return true;
+  m_finished = true;
+  return deflate(Z_FINISH);
+}
+
+} // namespace protocol
+} // namespace evio
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <zlib.h>
+#include <ostream>
+#include <streambuf>
+
+namespace evio {
+namespace protocol {
+
+// A streambuf that compresses everything that is written to it and writes the result to a target streambuf.
+//
+// This is the deflate counterpart of InflateDecoder for request bodies. The Source side has no chain of
+// stages to insert it into: a Source (OutputStream) is itself a std::ostream that the encoders write to.
+// Therefore compression is done by wrapping the streambuf of that ostream. When the target is the
+// OutputStream of an OutputDevice, the compressed data goes directly into its output buffer.
+//
+// Memory use is bounded: data is compressed whenever s_input_buffer_size bytes were written.
+class DeflateStreamBuf : public std::streambuf
+{
+ public:
+  static constexpr size_t s_input_buffer_size = 16384;
+
+ private:
+  std::streambuf* m_target;
+  z_stream m_zstream;
+  bool m_finished;
+  char m_input_buffer[s_input_buffer_size];
+
+ public:
+  // Use gzip = true for "Content-Encoding: gzip" and false for "Content-Encoding: deflate" (zlib format).
+  DeflateStreamBuf(std::streambuf* target, bool gzip, int level = Z_DEFAULT_COMPRESSION);
+  ~DeflateStreamBuf() { deflateEnd(&m_zstream); }
+
+  // Compress the remaining data and write the trailer of the compressed stream.
+  // Nothing may be written after this. Returns false if writing to the target failed.
+  bool finish();
+
+  // The total number of compressed bytes written to the target so far.
+  size_t total_out() const { return m_zstream.total_out; }
+
+ protected:
+  int_type overflow(int_type c) override;
+
+ private:
+  bool deflate(int flush);
+};
+
+// std::ostream interface to DeflateStreamBuf. For example,
+//
+//   std::ostringstream body;
+//   DeflateOutputStream gzip_body(body);
+//   gzip_body << ...;
+//   gzip_body.finish();
+//   encoder.write_message(header_template_with_content_encoding_gzip, body.str());
+//
+class DeflateOutputStream : public std::ostream
+{
+ private:
+  DeflateStreamBuf m_deflate_streambuf;
+
+ public:
+  DeflateOutputStream(std::ostream& target, bool gzip = true, int level = Z_DEFAULT_COMPRESSION) :
+    std::ostream(nullptr), m_deflate_streambuf(target.rdbuf(), gzip, level) { rdbuf(&m_deflate_streambuf); }
+
+  void finish() { if (!m_deflate_streambuf.finish()) setstate(std::ios_base::badbit); }
+  size_t total_out() const { return m_deflate_streambuf.total_out(); }
+};
+
+} // namespace protocol
+} // namespace evio
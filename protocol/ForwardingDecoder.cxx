@@ -0,0 +1,100 @@
+#include "sys.h"
+#include "ForwardingDecoder.h"
+#include "utils/malloc_size.h"
+#include "debug.h"
+#include <cstring>
+#ifdef CWDEBUG
+#include "utils/debug_ostream_operators.h"
+#endif
+
+namespace evio {
+namespace protocol {
+
+void ForwardingDecoder::forward(int& allow_deletion_count, MsgBlock&& piece)
+{
+  DoutEntering(dc::decoder, "ForwardingDecoder::forward({" << allow_deletion_count << "}, " << piece << ") [" << this << ']');
+
+  // Call set_inner_decoder first.
+  ASSERT(m_inner_decoder);
+
+  int const prev_allow_deletion_count = allow_deletion_count;
+  char const* new_data = piece.get_start();
+  size_t rlen = piece.get_size();
+
+  while (rlen > 0)
+  {
+    size_t len = m_inner_decoder->end_of_msg_finder(new_data, rlen, m_inner_result);
+    if (len == 0)
+    {
+      // The rest of this piece is the beginning of a message that continues in the next piece.
+      append_partial(new_data, rlen);
+      return;
+    }
+    // Only Decoder is supported as inner decoder.
+    ASSERT(m_inner_result.m_sink_type == decoder_sink);
+
+    if (m_partial_len > 0)
+    {
+      // Complete the message that was started in a previous piece.
+      append_partial(new_data, len);
+      size_t const msg_len = m_partial_len;
+      m_partial_len = 0;
+      m_inner_decoder->decode(allow_deletion_count, MsgBlock(m_partial_block->block_start(), msg_len, m_partial_block));
+    }
+    else if (len == rlen && new_data == piece.get_start())
+      m_inner_decoder->decode(allow_deletion_count, std::move(piece));
+    else
+    {
+      // Pass a slice of piece.
+      MsgBlock msg(piece);
+      msg.remove_prefix(new_data - piece.get_start());
+      msg.remove_suffix(rlen - len);
+      m_inner_decoder->decode(allow_deletion_count, std::move(msg));
+    }
+
+    if (AI_UNLIKELY(allow_deletion_count > prev_allow_deletion_count))
+    {
+      Dout(dc::decoder, "Stopping with forwarding because the inner decoder closed the device.");
+      return;
+    }
+
+    m_inner_result.reset();
+    rlen -= len;
+    new_data += len;
+  }
+}
+
+void ForwardingDecoder::append_partial(char const* data, size_t len)
+{
+  size_t const required_size = m_partial_len + len;
+  // We may only write to m_partial_block when nobody else (still) holds a MsgBlock that refers to it.
+  if (!m_partial_block || m_partial_block->get_size() < required_size || !m_partial_block->unique().is_true())
+  {
+    size_t block_size = std::max(required_size, m_inner_decoder->minimum_block_size());
+    block_size = utils::malloc_size(block_size + sizeof(MemoryBlock)) - sizeof(MemoryBlock);
+    MemoryBlock* memory_block = MemoryBlock::create(block_size);
+    AllocTag((void*)memory_block, "ForwardingDecoder: memory block to make message contiguous");
+    if (m_partial_block)
+    {
+      // Only when m_partial_len > 0 do we own m_partial_block exclusively.
+      if (m_partial_len > 0)
+        std::memcpy(memory_block->block_start(), m_partial_block->block_start(), m_partial_len);
+      m_partial_block->release();
+    }
+    m_partial_block = memory_block;
+  }
+  std::memcpy(m_partial_block->block_start() + m_partial_len, data, len);
+  m_partial_len = required_size;
+}
+
+size_t ForwardingDecoder::discard_partial_message()
+{
+  size_t discarded = m_partial_len;
+  Dout(dc::warning(discarded > 0), "ForwardingDecoder: discarding " << discarded << " bytes of incomplete message at end of payload.");
+  m_partial_len = 0;
+  m_inner_result.reset();
+  return discarded;
+}
+
+} // namespace protocol
+} // namespace evio
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Decoder.h"
+
+namespace evio {
+namespace protocol {
+
+// Base class of decoders that strip (or otherwise transform) an outer framing
+// and pass the payload on to an inner Decoder; for example http::ChunkedDecoder.
+//
+// The payload is passed to forward() in arbitrary pieces. Those pieces are cut
+// into messages by calling the end_of_msg_finder of the inner decoder, exactly
+// like InputDevice::data_received does. A message that lies entirely inside
+// a single piece is passed on as a slice of that piece (no copying); only a
+// message that spans more than one piece is reassembled in a separate
+// MemoryBlock.
+//
+// The inner decoder is not installed on the input device; it must therefore not
+// call switch_protocol_decoder. Its end_of_content is called by the derived class
+// when the payload ends.
+//
+class ForwardingDecoder : public Decoder
+{
+ protected:
+  Decoder* m_inner_decoder;                     // The decoder that the payload is passed to.
+  EndOfMsgFinderResult m_inner_result;          // Passed to m_inner_decoder->end_of_msg_finder.
+  MemoryBlock* m_partial_block;                 // Storage for a message that spans more than one piece, or nullptr.
+  size_t m_partial_len;                         // The number of bytes in m_partial_block.
+
+ public:
+  ForwardingDecoder() : m_inner_decoder(nullptr), m_partial_block(nullptr), m_partial_len(0) { }
+  ~ForwardingDecoder() { if (m_partial_block) m_partial_block->release(); }
+
+  // Set the decoder that the payload must be passed to.
+  // The caller must also call initialize_inner_sink(inner_decoder) when it switches to this decoder.
+  void set_inner_decoder(Decoder& inner_decoder)
+  {
+    m_inner_decoder = &inner_decoder;
+    m_inner_result.reset();
+    m_partial_len = 0;
+  }
+
+  // The messages of the payload determine what is a good buffer size.
+  size_t average_message_length() const override { return m_inner_decoder ? m_inner_decoder->average_message_length() : Decoder::average_message_length(); }
+
+ protected:
+  // Pass a piece of the payload to the inner decoder.
+  void forward(int& allow_deletion_count, MsgBlock&& piece);
+
+  // Call at the end of the payload. Returns the number of trailing bytes that did not form a complete message (they are discarded).
+  size_t discard_partial_message();
+
+ private:
+  void append_partial(char const* data, size_t len);
+};
+
+} // namespace protocol
+} // namespace evio
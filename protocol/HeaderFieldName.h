@@ -0,0 +1,222 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace evio {
+namespace protocol {
+namespace http {
+
+// List of well-known header field names: X(identifier, canonical spelling).
+#define EVIO_HTTP_KNOWN_HEADER_FIELDS(X) \
+  X(accept, "Accept") \
+  X(accept_charset, "Accept-Charset") \
+  X(accept_encoding, "Accept-Encoding") \
+  X(accept_language, "Accept-Language") \
+  X(accept_ranges, "Accept-Ranges") \
+  X(access_control_allow_origin, "Access-Control-Allow-Origin") \
+  X(age, "Age") \
+  X(allow, "Allow") \
+  X(authorization, "Authorization") \
+  X(cache_control, "Cache-Control") \
+  X(connection, "Connection") \
+  X(content_disposition, "Content-Disposition") \
+  X(content_encoding, "Content-Encoding") \
+  X(content_language, "Content-Language") \
+  X(content_length, "Content-Length") \
+  X(content_location, "Content-Location") \
+  X(content_range, "Content-Range") \
+  X(content_type, "Content-Type") \
+  X(cookie, "Cookie") \
+  X(date, "Date") \
+  X(etag, "ETag") \
+  X(expect, "Expect") \
+  X(expires, "Expires") \
+  X(host, "Host") \
+  X(if_match, "If-Match") \
+  X(if_modified_since, "If-Modified-Since") \
+  X(if_none_match, "If-None-Match") \
+  X(if_range, "If-Range") \
+  X(if_unmodified_since, "If-Unmodified-Since") \
+  X(keep_alive, "Keep-Alive") \
+  X(last_modified, "Last-Modified") \
+  X(link, "Link") \
+  X(location, "Location") \
+  X(origin, "Origin") \
+  X(pragma, "Pragma") \
+  X(proxy_authenticate, "Proxy-Authenticate") \
+  X(proxy_authorization, "Proxy-Authorization") \
+  X(range, "Range") \
+  X(referer, "Referer") \
+  X(retry_after, "Retry-After") \
+  X(sec_websocket_accept, "Sec-WebSocket-Accept") \
+  X(sec_websocket_extensions, "Sec-WebSocket-Extensions") \
+  X(sec_websocket_key, "Sec-WebSocket-Key") \
+  X(sec_websocket_protocol, "Sec-WebSocket-Protocol") \
+  X(sec_websocket_version, "Sec-WebSocket-Version") \
+  X(server, "Server") \
+  X(set_cookie, "Set-Cookie") \
+  X(strict_transport_security, "Strict-Transport-Security") \
+  X(te, "TE") \
+  X(trailer, "Trailer") \
+  X(transfer_encoding, "Transfer-Encoding") \
+  X(upgrade, "Upgrade") \
+  X(user_agent, "User-Agent") \
+  X(vary, "Vary") \
+  X(via, "Via") \
+  X(warning, "Warning") \
+  X(www_authenticate, "WWW-Authenticate") \
+  X(x_forwarded_for, "X-Forwarded-For") \
+  X(x_frame_options, "X-Frame-Options")
+
+enum known_header_field : uint8_t {
+#define EVIO_HTTP_HEADER_FIELD_ENUMERATOR(id, name) hf_##id,
+  EVIO_HTTP_KNOWN_HEADER_FIELDS(EVIO_HTTP_HEADER_FIELD_ENUMERATOR)
+#undef EVIO_HTTP_HEADER_FIELD_ENUMERATOR
+  number_of_known_header_fields,
+  hf_unknown = number_of_known_header_fields
+};
+
+// Copy len characters from in to out while converting ASCII upper case letters to lower case.
+inline void ascii_to_lower(char* out, char const* in, size_t len)
+{
+  size_t i = 0;
+#ifdef __SSE2__
+  __m128i const before_A = _mm_set1_epi8('A' - 1);
+  __m128i const after_Z = _mm_set1_epi8('Z' + 1);
+  __m128i const case_bit = _mm_set1_epi8(0x20);
+  for (; i + 16 <= len; i += 16)
+  {
+    __m128i c = _mm_loadu_si128(reinterpret_cast<__m128i const*>(in + i));
+    // Bytes >= 0x80 are negative and therefore never between 'A' and 'Z'.
+    __m128i is_upper = _mm_and_si128(_mm_cmpgt_epi8(c, before_A), _mm_cmplt_epi8(c, after_Z));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_or_si128(c, _mm_and_si128(is_upper, case_bit)));
+  }
+#endif
+  for (; i < len; ++i)
+  {
+    char c = in[i];
+    out[i] = ('A' <= c && c <= 'Z') ? c | 0x20 : c;
+  }
+}
+
+// FNV-1a hash of an (already) lower case string.
+constexpr uint32_t lower_case_hash(char const* lower_case_str, size_t len, uint32_t seed = 2166136261U)
+{
+  uint32_t hash = seed;
+  for (size_t i = 0; i < len; ++i)
+  {
+    hash ^= static_cast<unsigned char>(lower_case_str[i]);
+    hash *= 16777619U;
+  }
+  return hash ^ (hash >> 16);
+}
+
+namespace detail {
+
+constexpr size_t max_known_header_field_length = 32;    // At least the length of the longest known name.
+constexpr size_t known_header_field_table_size = 256;   // Must be a power of two.
+
+struct KnownHeaderFieldName
+{
+  char m_lower_case[max_known_header_field_length];
+  size_t m_length;
+};
+
+constexpr KnownHeaderFieldName make_known_header_field_name(std::string_view name)
+{
+  KnownHeaderFieldName result{};
+  for (size_t i = 0; i < name.size(); ++i)
+  {
+    char c = name[i];
+    result.m_lower_case[i] = ('A' <= c && c <= 'Z') ? c | 0x20 : c;
+  }
+  result.m_length = name.size();
+  return result;
+}
+
+constexpr std::array<std::string_view, number_of_known_header_fields> known_header_field_names = {
+#define EVIO_HTTP_HEADER_FIELD_NAME(id, name) name,
+  EVIO_HTTP_KNOWN_HEADER_FIELDS(EVIO_HTTP_HEADER_FIELD_NAME)
+#undef EVIO_HTTP_HEADER_FIELD_NAME
+};
+
+constexpr std::array<KnownHeaderFieldName, number_of_known_header_fields> known_header_field_lower_case_names = {
+#define EVIO_HTTP_HEADER_FIELD_LOWER_CASE_NAME(id, name) make_known_header_field_name(name),
+  EVIO_HTTP_KNOWN_HEADER_FIELDS(EVIO_HTTP_HEADER_FIELD_LOWER_CASE_NAME)
+#undef EVIO_HTTP_HEADER_FIELD_LOWER_CASE_NAME
+};
+
+constexpr size_t known_header_field_slot(uint32_t hash) { return hash & (known_header_field_table_size - 1); }
+
+// Find a seed for lower_case_hash for which all known header field names map to a different slot.
+constexpr uint32_t find_perfect_hash_seed()
+{
+  for (uint32_t seed = 2166136261U; seed < 2166136261U + 100000; ++seed)
+  {
+    bool used[known_header_field_table_size] = {};
+    bool collision = false;
+    for (auto const& name : known_header_field_lower_case_names)
+    {
+      size_t slot = known_header_field_slot(lower_case_hash(name.m_lower_case, name.m_length, seed));
+      if (used[slot])
+      {
+        collision = true;
+        break;
+      }
+      used[slot] = true;
+    }
+    if (!collision)
+      return seed;
+  }
+  return 0;
+}
+
+constexpr uint32_t perfect_hash_seed = find_perfect_hash_seed();
+static_assert(perfect_hash_seed != 0, "No perfect hash found for EVIO_HTTP_KNOWN_HEADER_FIELDS; increase known_header_field_table_size.");
+
+constexpr std::array<known_header_field, known_header_field_table_size> make_known_header_field_table()
+{
+  std::array<known_header_field, known_header_field_table_size> table{};
+  for (auto& entry : table)
+    entry = hf_unknown;
+  for (size_t i = 0; i < number_of_known_header_fields; ++i)
+  {
+    auto const& name = known_header_field_lower_case_names[i];
+    table[known_header_field_slot(lower_case_hash(name.m_lower_case, name.m_length, perfect_hash_seed))] = static_cast<known_header_field>(i);
+  }
+  return table;
+}
+
+constexpr std::array<known_header_field, known_header_field_table_size> known_header_field_table = make_known_header_field_table();
+
+} // namespace detail
+
+// Returns the canonical spelling of a known header field name.
+inline std::string_view known_header_field_name(known_header_field id)
+{
+  return detail::known_header_field_names[id];
+}
+
+// Case-insensitive lookup of a header field name. Returns hf_unknown if the name isn't well-known.
+inline known_header_field lookup_known_header_field(std::string_view name)
+{
+  if (name.size() > detail::max_known_header_field_length)
+    return hf_unknown;
+  char lower_case[detail::max_known_header_field_length];
+  ascii_to_lower(lower_case, name.data(), name.size());
+  known_header_field id = detail::known_header_field_table[detail::known_header_field_slot(lower_case_hash(lower_case, name.size(), detail::perfect_hash_seed))];
+  if (id == hf_unknown)
+    return hf_unknown;
+  auto const& known_name = detail::known_header_field_lower_case_names[id];
+  return (known_name.m_length == name.size() && std::memcmp(known_name.m_lower_case, lower_case, name.size()) == 0) ? id : hf_unknown;
+}
+
+} // namespace http
+} // namespace protocol
+} // namespace evio
@@ -0,0 +1,143 @@
+#include "sys.h"
+#include "InflateDecoder.h"
+#include "utils/malloc_size.h"
+#include "debug.h"
+#ifdef CWDEBUG
+#include "utils/debug_ostream_operators.h"
+#endif
+
+namespace evio {
+namespace protocol {
+
+namespace {
+
+// Let zlib detect gzip or zlib format from the header (see inflateInit2).
+constexpr int window_bits_auto = 15 + 32;
+// Raw deflate data without any header.
+constexpr int window_bits_raw = -15;
+
+} // namespace
+
+InflateDecoder::~InflateDecoder()
+{
+  if (m_initialized)
+    inflateEnd(&m_zstream);
+  if (m_output_block)
+    m_output_block->release();
+}
+
+void InflateDecoder::reset_zstream(int window_bits)
+{
+  if (m_initialized)
+  {
+    inflateEnd(&m_zstream);
+    m_initialized = false;
+  }
+  m_zstream = z_stream{};
+  int ret = inflateInit2(&m_zstream, window_bits);
+  if (ret != Z_OK)
+    THROW_ALERT("inflateInit2 failed: [ERROR]", AIArgs("[ERROR]", m_zstream.msg ? m_zstream.msg : zError(ret)));
+  m_initialized = true;
+}
+
+void InflateDecoder::start(Decoder& inner_decoder, bool deflate)
+{
+  DoutEntering(dc::decoder, "InflateDecoder::start(" << &inner_decoder << ", " << deflate << ") [" << this << ']');
+  set_inner_decoder(inner_decoder);
+  m_detect_raw_deflate = deflate;
+  m_have_first_byte = false;
+  if (m_initialized)
+    inflateReset2(&m_zstream, window_bits_auto);
+  else
+    reset_zstream(window_bits_auto);
+}
+
+size_t InflateDecoder::end_of_msg_finder(char const* UNUSED_ARG(new_data), size_t rlen, EndOfMsgFinderResult& UNUSED_ARG(result))
+{
+  // Inflate whatever was received.
+  return rlen;
+}
+
+void InflateDecoder::decode(int& allow_deletion_count, MsgBlock&& msg)
+{
+  DoutEntering(dc::decoder, "InflateDecoder::decode({" << allow_deletion_count << "}, " << msg << ") [" << this << ']');
+  try
+  {
+    char const* data = msg.get_start();
+    size_t len = msg.get_size();
+    if (AI_UNLIKELY(m_detect_raw_deflate))
+    {
+      // The first two bytes of a zlib stream are a header with a checksum (RFC1950).
+      if (!m_have_first_byte)
+      {
+        m_first_byte = *data++;
+        m_have_first_byte = true;
+        if (--len == 0)
+          return;
+      }
+      unsigned char second_byte = *data;
+      bool zlib_header = (m_first_byte & 0x0f) == Z_DEFLATED && ((m_first_byte << 8) | second_byte) % 31 == 0;
+      bool gzip_header = m_first_byte == 0x1f && second_byte == 0x8b;
+      if (!zlib_header && !gzip_header)
+      {
+        Dout(dc::decoder, "No zlib header; assuming raw deflate.");
+        reset_zstream(window_bits_raw);
+      }
+      m_detect_raw_deflate = false;
+      inflate(allow_deletion_count, reinterpret_cast<char const*>(&m_first_byte), 1);
+    }
+    inflate(allow_deletion_count, data, len);
+  }
+  catch (AIAlert::Error const& error)
+  {
+    Dout(dc::warning, error << " caught in InflateDecoder.cxx");
+    close_input_device(allow_deletion_count);
+  }
+}
+
+void InflateDecoder::inflate(int& allow_deletion_count, char const* data, size_t len)
+{
+  int const prev_allow_deletion_count = allow_deletion_count;
+  m_zstream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+  m_zstream.avail_in = len;
+  do
+  {
+    // We may only write to m_output_block when nobody else (still) holds a MsgBlock that refers to it.
+    if (!m_output_block || !m_output_block->unique().is_true())
+    {
+      if (m_output_block)
+        m_output_block->release();
+      m_output_block = MemoryBlock::create(utils::malloc_size(s_output_block_size + sizeof(MemoryBlock)) - sizeof(MemoryBlock));
+      AllocTag((void*)m_output_block, "InflateDecoder: memory block for inflated data");
+    }
+    m_zstream.next_out = reinterpret_cast<Bytef*>(m_output_block->block_start());
+    size_t const block_size = m_output_block->get_size();
+    m_zstream.avail_out = block_size;
+    int ret = ::inflate(&m_zstream, Z_NO_FLUSH);
+    if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+      THROW_ALERT("inflate failed: [ERROR]", AIArgs("[ERROR]", m_zstream.msg ? m_zstream.msg : zError(ret)));
+    size_t produced = block_size - m_zstream.avail_out;
+    if (produced > 0)
+    {
+      forward(allow_deletion_count, MsgBlock(m_output_block->block_start(), produced, m_output_block));
+      if (AI_UNLIKELY(allow_deletion_count > prev_allow_deletion_count))
+        return;
+    }
+    // A gzip payload can consist of multiple members.
+    if (ret == Z_STREAM_END && m_zstream.avail_in > 0)
+      inflateReset(&m_zstream);
+    else if (ret == Z_BUF_ERROR || (produced < block_size && m_zstream.avail_in == 0))
+      break;
+  }
+  while (true);
+}
+
+void InflateDecoder::end_of_content(int& allow_deletion_count)
+{
+  DoutEntering(dc::decoder, "InflateDecoder::end_of_content({" << allow_deletion_count << "}) [" << this << ']');
+  discard_partial_message();
+  m_inner_decoder->end_of_content(allow_deletion_count);
+}
+
+} // namespace protocol
+} // namespace evio
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "ForwardingDecoder.h"
+#include <zlib.h>
+
+namespace evio {
+namespace protocol {
+
+// Decoder for a payload with "Content-Encoding: gzip" or "Content-Encoding: deflate".
+//
+// Each received piece of compressed data is inflated immediately, into
+// MemoryBlocks of at most s_output_block_size bytes, which are passed to the
+// inner decoder (see ForwardingDecoder). Hence the memory use does not depend
+// on the size of the payload, only on the size of the messages of the inner decoder.
+//
+// When this decoder is installed with set_next_decoder, end_of_content of the
+// inner decoder is called from end_of_content of this decoder.
+//
+class InflateDecoder : public ForwardingDecoder
+{
+ public:
+  static constexpr size_t s_output_block_size = 16384;
+
+ private:
+  z_stream m_zstream;
+  bool m_initialized;                           // Set when inflateInit2 was called successfully.
+  bool m_detect_raw_deflate;                    // Set while it is not known yet if "deflate" data has a zlib header.
+  bool m_have_first_byte;                       // Set when m_first_byte is valid.
+  unsigned char m_first_byte;                   // The first byte of the payload, while m_detect_raw_deflate is set.
+  MemoryBlock* m_output_block;                  // The block that inflate writes to.
+
+ public:
+  InflateDecoder() : m_zstream{}, m_initialized(false), m_detect_raw_deflate(false), m_have_first_byte(false), m_first_byte(0), m_output_block(nullptr) { }
+  ~InflateDecoder();
+
+  // Prepare for inflating a new payload that must be passed to inner_decoder.
+  // Both gzip and zlib formats are detected automatically; pass deflate = true
+  // to also accept a raw deflate stream (what some servers send for "deflate").
+  //
+  // The caller must call initialize_inner_sink(inner_decoder) and then switch to this decoder.
+  void start(Decoder& inner_decoder, bool deflate);
+
+  // The end of the payload was reached.
+  void end_of_content(int& allow_deletion_count) override;
+
+ protected:
+  size_t end_of_msg_finder(char const* new_data, size_t rlen, EndOfMsgFinderResult& result) override;
+  void decode(int& allow_deletion_count, MsgBlock&& msg) override;
+
+ private:
+  void inflate(int& allow_deletion_count, char const* data, size_t len);
+  void reset_zstream(int window_bits);
+};
+
+} // namespace protocol
+} // namespace evio
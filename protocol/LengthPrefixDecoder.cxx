@@ -0,0 +1,119 @@
+#include "sys.h"
+#include "LengthPrefixDecoder.h"
+#include "CRC32C.h"
+#include "utils/AIAlert.h"
+#include <algorithm>
+#include "debug.h"
+
+namespace evio {
+namespace protocol {
+
+LengthPrefixDecoder::LengthPrefixDecoder(LengthPrefixFormat const& format, size_t max_payload_size) :
+  m_format(format), m_max_payload_size(max_payload_size), m_header_seen(0), m_header_complete(false),
+  m_length(0), m_remaining(0), m_header_size(0), m_bad_header(false)
+{
+  // The size of a fixed size length must be 1, 2, 4 or 8.
+  ASSERT(format.m_encoding == LengthPrefixFormat::varint ||
+      format.m_length_size == 1 || format.m_length_size == 2 || format.m_length_size == 4 || format.m_length_size == 8);
+}
+
+// Process the next byte of the header. Returns true if this was the last byte of the header.
+bool LengthPrefixDecoder::add_header_byte(uint8_t c)
+{
+  if (m_header_seen++ < m_format.m_length_offset)
+    return false;
+  size_t const pos = m_header_seen - 1 - m_format.m_length_offset;        // The index of c in the length.
+  switch (m_format.m_encoding)
+  {
+    case LengthPrefixFormat::big_endian:
+      m_length = (m_length << 8) | c;
+      return pos + 1 == static_cast<size_t>(m_format.m_length_size);
+    case LengthPrefixFormat::little_endian:
+      m_length |= static_cast<uint64_t>(c) << (8 * pos);
+      return pos + 1 == static_cast<size_t>(m_format.m_length_size);
+    case LengthPrefixFormat::varint:
+      if (pos == s_max_varint_size - 1 && c > 1)
+      {
+        // More than 64 bits.
+        m_bad_header = true;
+        return true;
+      }
+      m_length |= static_cast<uint64_t>(c & 0x7f) << (7 * pos);
+      return !(c & 0x80);
+  }
+  AI_NEVER_REACHED
+}
+
+size_t LengthPrefixDecoder::end_of_msg_finder(char const* new_data, size_t rlen, EndOfMsgFinderResult& UNUSED_ARG(result))
+{
+  DoutEntering(dc::endofmsg, "LengthPrefixDecoder::end_of_msg_finder(..., " << rlen << ")");
+  size_t i = 0;
+  if (!m_header_complete)
+  {
+    while (i < rlen && !m_header_complete)
+      m_header_complete = add_header_byte(new_data[i++]);
+    if (!m_header_complete)
+      return 0;
+    if (m_length > m_max_payload_size)
+      m_bad_header = true;
+    if (m_bad_header)
+    {
+      // Pass just the header to decode, which closes the input device.
+      m_header_size = m_header_seen;
+      m_header_seen = 0;
+      m_header_complete = false;
+      m_length = 0;
+      return i;
+    }
+    m_remaining = m_length + (m_format.m_crc32c ? s_crc32c_size : 0);
+  }
+  size_t len = std::min(static_cast<uint64_t>(rlen - i), m_remaining);
+  m_remaining -= len;
+  if (m_remaining > 0)
+    return 0;
+  m_header_size = m_header_seen;
+  m_header_seen = 0;
+  m_header_complete = false;
+  m_length = 0;
+  return i + len;
+}
+
+uint32_t LengthPrefixDecoder::read_crc32c(char const* ptr) const
+{
+  unsigned char const* p = reinterpret_cast<unsigned char const*>(ptr);
+  if (m_format.m_encoding == LengthPrefixFormat::big_endian)
+    return uint32_t{p[0]} << 24 | uint32_t{p[1]} << 16 | uint32_t{p[2]} << 8 | p[3];
+  return uint32_t{p[3]} << 24 | uint32_t{p[2]} << 16 | uint32_t{p[1]} << 8 | p[0];
+}
+
+void LengthPrefixDecoder::decode(int& allow_deletion_count, MsgBlock&& msg)
+{
+  DoutEntering(dc::decoder, "LengthPrefixDecoder::decode({" << allow_deletion_count << "}, " << msg << ") [" << this << ']');
+  try
+  {
+    if (m_bad_header)
+    {
+      m_bad_header = false;
+      THROW_ALERT("Received a frame with an invalid length (more than [MAX] bytes)", AIArgs("[MAX]", m_max_payload_size));
+    }
+    size_t payload_size = msg.get_size() - m_header_size;
+    if (m_format.m_crc32c)
+    {
+      payload_size -= s_crc32c_size;
+      char const* trailer = msg.get_start() + m_header_size + payload_size;
+      if (crc32c(msg.get_start(), m_header_size + payload_size) != read_crc32c(trailer))
+        THROW_ALERT("Received a frame with a wrong CRC32C");
+    }
+    std::string_view header(msg.get_start(), m_header_size);
+    MsgBlock payload = msg.slice({msg.get_start() + m_header_size, payload_size});
+    frame_received(allow_deletion_count, header, std::move(payload));
+  }
+  catch (AIAlert::Error const& error)
+  {
+    Dout(dc::warning, error << " caught in LengthPrefixDecoder.cxx");
+    close_input_device(allow_deletion_count);
+  }
+}
+
+} // namespace protocol
+} // namespace evio
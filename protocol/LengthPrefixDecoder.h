@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Decoder.h"
+#include <cstdint>
+#include <string_view>
+
+namespace evio {
+namespace protocol {
+
+// The layout of a length prefixed frame:
+//
+//   [m_length_offset bytes][length][length bytes of payload][CRC32C]
+//
+// The length is either a fixed size unsigned integer or a varint (LEB128: seven bits per byte,
+// least significant group first, the high bit set on all but the last byte), and counts only
+// the payload. The optional CRC32C is four bytes in the byte order of the length (little endian
+// for a varint), and covers everything before it.
+struct LengthPrefixFormat
+{
+  enum encoding_type {
+    big_endian,
+    little_endian,
+    varint
+  };
+
+  encoding_type m_encoding = big_endian;
+  int m_length_size = 4;                // 1, 2, 4 or 8. Not used for varint.
+  size_t m_length_offset = 0;           // The number of header bytes before the length.
+  bool m_crc32c = false;                // Set if the payload is followed by a CRC32C.
+};
+
+// Decoder for length prefixed binary frames.
+//
+// The frame boundaries are found by end_of_msg_finder, so that every frame
+// is passed to decode as a single MsgBlock, straight from the input buffer.
+// The payload is passed on to frame_received as a slice of that MsgBlock.
+// A frame is only copied when it doesn't fit in the remainder of a buffer block;
+// override average_message_length to make that rare.
+//
+// A frame with a payload larger than the given maximum, or with a wrong CRC32C,
+// closes the input device.
+//
+// Derive from this class and override frame_received.
+//
+class LengthPrefixDecoder : public Decoder
+{
+ public:
+  static constexpr size_t s_default_max_payload_size = 16 * 1024 * 1024;
+  static constexpr int s_max_varint_size = 10;
+  static constexpr size_t s_crc32c_size = 4;
+
+ private:
+  LengthPrefixFormat const m_format;
+  size_t const m_max_payload_size;
+  size_t m_header_seen;                 // The number of header bytes of the current frame seen by end_of_msg_finder.
+  bool m_header_complete;               // Set when the whole header of the current frame was seen.
+  uint64_t m_length;                    // The (partially) decoded length of the current frame.
+  uint64_t m_remaining;                 // The number of bytes of the current frame still to be seen, once the header is complete.
+  size_t m_header_size;                 // The header size of the frame that is passed to decode next.
+  bool m_bad_header;                    // Set if the header of the frame passed to decode next is invalid.
+
+ public:
+  LengthPrefixDecoder(LengthPrefixFormat const& format, size_t max_payload_size = s_default_max_payload_size);
+
+ protected:
+  size_t end_of_msg_finder(char const* new_data, size_t rlen, EndOfMsgFinderResult& result) override;
+  // end_of_msg_finder parses the frame header that decode uses.
+  bool has_stateless_end_of_msg_finder() const override { return false; }
+  void decode(int& allow_deletion_count, MsgBlock&& msg) final;
+
+  // Called for every frame. header contains the bytes before the payload,
+  // and refers to the same memory as payload.
+  virtual void frame_received(int& allow_deletion_count, std::string_view header, MsgBlock&& payload) = 0;
+
+ private:
+  bool add_header_byte(uint8_t c);
+  uint32_t read_crc32c(char const* ptr) const;
+};
+
+} // namespace protocol
+} // namespace evio
@@ -0,0 +1,118 @@
+#include "sys.h"
+#include "MessageEncoder.h"
+#include <charconv>
+#include <cstring>
+#include <ostream>
+#include "debug.h"
+
+namespace evio {
+namespace protocol {
+namespace http {
+
+MessageHeaderTemplate::MessageHeaderTemplate(std::string_view start_line, header_fields_type static_header_fields, bool add_date) :
+  m_static_block(start_line), m_add_date(add_date)
+{
+  m_static_block += "\r\n";
+  for (auto&& header_field : static_header_fields)
+  {
+    m_static_block += header_field.first;
+    m_static_block += ": ";
+    m_static_block += header_field.second;
+    m_static_block += "\r\n";
+  }
+}
+
+//static
+MessageHeaderTemplate MessageHeaderTemplate::response(int status_code, std::string_view reason_phrase, header_fields_type static_header_fields)
+{
+  // status-code must be three digits.
+  ASSERT(100 <= status_code && status_code <= 999);
+  std::string start_line{"HTTP/1.1 "};
+  start_line += std::to_string(status_code);
+  start_line += ' ';
+  start_line += reason_phrase;
+  return { start_line, static_header_fields, true };
+}
+
+std::string_view MessageEncoder::date_field()
+{
+  std::time_t now = std::time(nullptr);
+  if (now != m_date_time)
+  {
+    // IMF-fixdate, for example "Sun, 06 Nov 1994 08:49:37 GMT".
+    // The day and month names must be English, so strftime (which uses the locale) can't be used.
+    static constexpr char const* day_names[7] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+    static constexpr char const* month_names[12] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+    std::tm tm;
+    gmtime_r(&now, &tm);
+    auto two_digits = [](char* ptr, int value) { ptr[0] = '0' + value / 10; ptr[1] = '0' + value % 10; };
+    char* ptr = m_date_field;
+    std::memcpy(ptr, "Date: ", 6);
+    std::memcpy(ptr + 6, day_names[tm.tm_wday], 3);
+    std::memcpy(ptr + 9, ", ", 2);
+    two_digits(ptr + 11, tm.tm_mday);
+    ptr[13] = ' ';
+    std::memcpy(ptr + 14, month_names[tm.tm_mon], 3);
+    ptr[17] = ' ';
+    ptr = std::to_chars(ptr + 18, m_date_field + sizeof(m_date_field), tm.tm_year + 1900).ptr;
+    *ptr++ = ' ';
+    two_digits(ptr, tm.tm_hour);
+    ptr[2] = ':';
+    two_digits(ptr + 3, tm.tm_min);
+    ptr[5] = ':';
+    two_digits(ptr + 6, tm.tm_sec);
+    std::memcpy(ptr + 8, " GMT\r\n", 6);
+    m_date_field_length = ptr + 14 - m_date_field;
+    m_date_time = now;
+  }
+  return { m_date_field, m_date_field_length };
+}
+
+void MessageEncoder::write_header(MessageHeaderTemplate const& header_template, size_t content_length, std::string_view host)
+{
+  std::string_view static_block = header_template.static_block();
+  m_output.write(static_block.data(), static_block.size());
+
+  // Assemble the variable header fields so that they are written with a single call too.
+  static constexpr std::string_view host_prefix = "Host: ";
+  static constexpr std::string_view content_length_prefix = "Content-Length: ";
+  static constexpr size_t max_host_length = 256;
+  char buf[host_prefix.size() + max_host_length + 2 + sizeof(m_date_field) + content_length_prefix.size() + 20 + 4];
+  char* ptr = buf;
+  if (!host.empty())
+  {
+    if (AI_UNLIKELY(host.size() > max_host_length))
+      m_output << host_prefix << host << "\r\n";
+    else
+    {
+      std::memcpy(ptr, host_prefix.data(), host_prefix.size());
+      ptr += host_prefix.size();
+      std::memcpy(ptr, host.data(), host.size());
+      ptr += host.size();
+      *ptr++ = '\r';
+      *ptr++ = '\n';
+    }
+  }
+  if (header_template.add_date())
+  {
+    std::string_view date = date_field();
+    std::memcpy(ptr, date.data(), date.size());
+    ptr += date.size();
+  }
+  std::memcpy(ptr, content_length_prefix.data(), content_length_prefix.size());
+  ptr += content_length_prefix.size();
+  ptr = std::to_chars(ptr, buf + sizeof(buf), content_length).ptr;
+  std::memcpy(ptr, "\r\n\r\n", 4);
+  ptr += 4;
+  m_output.write(buf, ptr - buf);
+}
+
+void MessageEncoder::write_message(MessageHeaderTemplate const& header_template, std::string_view body, std::string_view host)
+{
+  write_header(header_template, body.size(), host);
+  m_output.write(body.data(), body.size());
+}
+
+} // namespace http
+} // namespace protocol
+} // namespace evio
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <ctime>
+#include <initializer_list>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace evio {
+namespace protocol {
+namespace http {
+
+// A pre-rendered start line plus the header fields that never change for a given endpoint.
+//
+// For example,
+//
+//   MessageHeaderTemplate const rpc_post = MessageHeaderTemplate::request("POST", "/RPC2",
+//       {{ "User-Agent", "evio" }, { "Content-Type", "text/xml" }});
+//
+// The variable header fields Host, Date and Content-Length are added by MessageEncoder.
+//
+class MessageHeaderTemplate
+{
+ private:
+  std::string m_static_block;           // start-line CRLF *( header-field CRLF )
+  bool m_add_date;                      // Add a Date header field to each message.
+
+ public:
+  using header_fields_type = std::initializer_list<std::pair<std::string_view, std::string_view>>;
+
+  MessageHeaderTemplate(std::string_view start_line, header_fields_type static_header_fields, bool add_date);
+
+  // request-line = method SP request-target SP HTTP-version CRLF
+  static MessageHeaderTemplate request(std::string_view method, std::string_view request_target, header_fields_type static_header_fields = {})
+  {
+    std::string start_line{method};
+    start_line += ' ';
+    start_line += request_target;
+    start_line += " HTTP/1.1";
+    return { start_line, static_header_fields, false };
+  }
+
+  // status-line = HTTP-version SP status-code SP reason-phrase CRLF
+  // An origin server must send a Date header field in its responses (RFC7231, section 7.1.1.2).
+  static MessageHeaderTemplate response(int status_code, std::string_view reason_phrase, header_fields_type static_header_fields = {});
+
+  std::string_view static_block() const { return m_static_block; }
+  bool add_date() const { return m_add_date; }
+};
+
+// Writes HTTP/1.1 messages to an ostream (normally an OutputStream).
+//
+// The static part of the header is copied in one go from a MessageHeaderTemplate;
+// only Host, Date and Content-Length are formatted per message.
+//
+class MessageEncoder
+{
+ private:
+  std::ostream& m_output;
+  std::time_t m_date_time;              // The second that m_date_field was formatted for.
+  char m_date_field[64];                // "Date: " IMF-fixdate CRLF
+  size_t m_date_field_length;
+
+ public:
+  MessageEncoder(std::ostream& output) : m_output(output), m_date_time(-1), m_date_field_length(0) { }
+
+  // Write the header of a message with a body of content_length bytes.
+  // Pass a non-empty host to add a Host header field (required for requests).
+  void write_header(MessageHeaderTemplate const& header_template, size_t content_length, std::string_view host = {});
+
+  // Write a whole message.
+  void write_message(MessageHeaderTemplate const& header_template, std::string_view body, std::string_view host = {});
+
+ private:
+  std::string_view date_field();
+};
+
+} // namespace http
+} // namespace protocol
+} // namespace evio
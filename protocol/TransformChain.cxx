@@ -0,0 +1,153 @@
+#include "sys.h"
+#include "TransformChain.h"
+#include "utils/AIAlert.h"
+#include "debug.h"
+
+namespace evio {
+namespace protocol {
+
+void TransformStage::emit(int& allow_deletion_count, MsgBlock&& piece)
+{
+  m_chain->pass_on(allow_deletion_count, m_index + 1, std::move(piece));
+}
+
+void TransformStage::set_buffered(size_t buffered)
+{
+  m_buffered = buffered;
+  m_chain->update_flow_control();
+}
+
+RefCountReleaser TransformStage::resume()
+{
+  // Add this stage to a chain first.
+  ASSERT(m_chain);
+  return m_chain->resume(*this);
+}
+
+void TransformChain::push_back(TransformStage& stage)
+{
+  stage.m_chain = this;
+  stage.m_index = m_stages.size();
+  m_stages.push_back(&stage);
+}
+
+size_t TransformChain::end_of_msg_finder(char const* UNUSED_ARG(new_data), size_t rlen, EndOfMsgFinderResult& UNUSED_ARG(result))
+{
+  // Let the decoder use the same input device as us.
+  if (AI_UNLIKELY(m_inner_input_device != m_input_device))
+  {
+    initialize_inner_sink(*m_inner_decoder);
+    m_inner_input_device = m_input_device;
+  }
+  // Transform whatever was received.
+  return rlen;
+}
+
+void TransformChain::decode(int& allow_deletion_count, MsgBlock&& msg)
+{
+  DoutEntering(dc::decoder, "TransformChain::decode({" << allow_deletion_count << "}, " << msg << ") [" << this << ']');
+  std::lock_guard<std::mutex> lock(m_mutex);
+  pass_on(allow_deletion_count, 0, std::move(msg));
+}
+
+void TransformChain::pass_on(int& allow_deletion_count, size_t index, MsgBlock&& piece)
+{
+  if (index == m_stages.size())
+  {
+    forward(allow_deletion_count, std::move(piece));
+    return;
+  }
+  try
+  {
+    m_stages[index]->transform(allow_deletion_count, std::move(piece));
+  }
+  catch (AIAlert::Error const& error)
+  {
+    Dout(dc::warning, error << " caught in TransformChain.cxx");
+    close_input_device(allow_deletion_count);
+  }
+}
+
+void TransformChain::end_of_content(int& allow_deletion_count)
+{
+  DoutEntering(dc::decoder, "TransformChain::end_of_content({" << allow_deletion_count << "}) [" << this << ']');
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!flush_stages(allow_deletion_count))
+    return;
+  discard_partial_message();
+  m_inner_decoder->end_of_content(allow_deletion_count);
+}
+
+void TransformChain::end_of_input(int& allow_deletion_count)
+{
+  DoutEntering(dc::decoder, "TransformChain::end_of_input({" << allow_deletion_count << "}) [" << this << ']');
+  // Without a content length the held data would otherwise be lost when the connection is closed.
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!flush_stages(allow_deletion_count))
+    return;
+  discard_partial_message();
+  m_inner_decoder->end_of_input(allow_deletion_count);
+}
+
+// Returns false if a stage threw, in which case the input device was closed.
+bool TransformChain::flush_stages(int& allow_deletion_count)
+{
+  try
+  {
+    // Flush the stages in order, so that everything reaches the decoder.
+    for (TransformStage* stage : m_stages)
+      stage->end_of_stream(allow_deletion_count);
+  }
+  catch (AIAlert::Error const& error)
+  {
+    Dout(dc::warning, error << " caught in TransformChain.cxx");
+    close_input_device(allow_deletion_count);
+    return false;
+  }
+  return true;
+}
+
+void TransformChain::update_flow_control()
+{
+  bool above_high_watermark = false;
+  bool above_low_watermark = false;
+  for (TransformStage const* stage : m_stages)
+  {
+    above_high_watermark |= stage->m_buffered > stage->m_high_watermark;
+    above_low_watermark |= stage->m_buffered > stage->m_low_watermark;
+  }
+  if (!m_stopped && above_high_watermark)
+  {
+    Dout(dc::decoder, "A transform stage exceeded its high watermark; stopping input device.");
+    m_stopped = true;
+    stop_input_device();
+  }
+  else if (m_stopped && !above_low_watermark)
+  {
+    Dout(dc::decoder, "All transform stages are below their low watermark; restarting input device.");
+    m_stopped = false;
+    restart_input_device();
+  }
+}
+
+RefCountReleaser TransformChain::resume(TransformStage& stage)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  // Not installed yet, or closed.
+  if (!m_inner_input_device || !is_input_device_readable())
+    return {};
+  int allow_deletion_count = 0;
+  try
+  {
+    stage.resumed(allow_deletion_count);
+  }
+  catch (AIAlert::Error const& error)
+  {
+    Dout(dc::warning, error << " caught in TransformChain.cxx");
+    close_input_device(allow_deletion_count);
+  }
+  return {m_input_device, allow_deletion_count};
+}
+
+} // namespace protocol
+} // namespace evio
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "ForwardingDecoder.h"
+#include "evio/RefCountReleaser.h"
+#include <mutex>
+#include <vector>
+
+namespace evio {
+namespace protocol {
+
+class TransformChain;
+
+// A byte transform between an input device and its protocol decoder (see TransformChain).
+//
+// A stage receives the data in arbitrary pieces (transform) and passes zero or
+// more pieces on to the next stage (emit). A piece that isn't changed should be
+// passed on as is, or as a slice, so that it isn't copied.
+//
+// A stage that keeps data must keep track of the number of bytes it holds with
+// set_buffered. When that exceeds the high watermark of the stage the input device
+// is stopped; it is started again when every stage of the chain holds no more than
+// its low watermark.
+//
+class TransformStage
+{
+ private:
+  friend class TransformChain;
+  TransformChain* m_chain;              // The chain that this stage was added to.
+  size_t m_index;                       // The position of this stage in m_chain.
+  size_t const m_high_watermark;
+  size_t const m_low_watermark;
+  size_t m_buffered;                    // The number of bytes that this stage holds.
+
+ public:
+  TransformStage(size_t high_watermark = 256 * 1024, size_t low_watermark = 64 * 1024) :
+    m_chain(nullptr), m_index(0), m_high_watermark(high_watermark), m_low_watermark(low_watermark), m_buffered(0)
+  {
+    ASSERT(low_watermark <= high_watermark);
+  }
+  virtual ~TransformStage() = default;
+
+  size_t buffered() const { return m_buffered; }
+
+ protected:
+  // Called with the next piece of the input.
+  virtual void transform(int& allow_deletion_count, MsgBlock&& piece) = 0;
+
+  // Called when the end of the content or the input is reached; pass on everything that is still held.
+  // Throw an AIAlert::Error if the stream is incomplete; that closes the input device.
+  virtual void end_of_stream(int& UNUSED_ARG(allow_deletion_count)) { }
+
+  // Called by resume().
+  virtual void resumed(int& UNUSED_ARG(allow_deletion_count)) { }
+
+  // Pass a piece on to the next stage, or to the decoder after the last stage.
+  void emit(int& allow_deletion_count, MsgBlock&& piece);
+
+  // Update the number of bytes that this stage holds.
+  void set_buffered(size_t buffered);
+
+  // Call resumed() from a thread that is not reading the device (for example from a timer).
+  // The returned releaser must be destroyed after the chain is no longer used.
+  RefCountReleaser resume();
+};
+
+// A Decoder that passes the received data through an ordered list of TransformStages
+// and then to a protocol decoder.
+//
+// The chain is installed on any input device, instead of the protocol decoder:
+//
+//   TransformChain m_chain{m_decoder};
+//   TapStage m_tap{...};
+//   InflateStage m_inflate;
+//   ...
+//   m_chain.push_back(m_tap);
+//   m_chain.push_back(m_inflate);
+//   device->set_protocol_decoder(m_chain);
+//
+// The output of the last stage is cut into messages by the end_of_msg_finder of the
+// protocol decoder, as slices of the MemoryBlocks that it was passed in (see ForwardingDecoder).
+//
+// An AIAlert::Error thrown by a stage closes the input device.
+//
+class TransformChain : public ForwardingDecoder
+{
+ private:
+  friend class TransformStage;
+  std::vector<TransformStage*> m_stages;
+  std::mutex m_mutex;                   // Serializes the reading thread with calls to TransformStage::resume.
+  InputDevice* m_inner_input_device;    // The input device that m_inner_decoder was initialized with.
+  bool m_stopped;                       // Set when the input device was stopped because a stage exceeded its high watermark.
+
+ public:
+  TransformChain(Decoder& decoder) : m_inner_input_device(nullptr), m_stopped(false) { set_inner_decoder(decoder); }
+
+  // Add a stage after the existing stages. Only call this before the chain is installed.
+  void push_back(TransformStage& stage);
+
+  void end_of_content(int& allow_deletion_count) override;
+  void end_of_input(int& allow_deletion_count) override;
+
+ protected:
+  size_t end_of_msg_finder(char const* new_data, size_t rlen, EndOfMsgFinderResult& result) override;
+  bool has_stateless_end_of_msg_finder() const override { return false; }
+  void decode(int& allow_deletion_count, MsgBlock&& msg) override;
+
+ private:
+  void pass_on(int& allow_deletion_count, size_t index, MsgBlock&& piece);
+  bool flush_stages(int& allow_deletion_count);
+  void update_flow_control();
+  RefCountReleaser resume(TransformStage& stage);
+};
+
+} // namespace protocol
+} // namespace evio
@@ -0,0 +1,126 @@
+#include "sys.h"
+#include "TransformStages.h"
+#include "utils/AIAlert.h"
+#include "utils/malloc_size.h"
+#include <algorithm>
+#include "debug.h"
+
+namespace evio {
+namespace protocol {
+
+InflateStage::~InflateStage()
+{
+  if (m_initialized)
+    inflateEnd(&m_zstream);
+  if (m_output_block)
+    m_output_block->release();
+}
+
+void InflateStage::transform(int& allow_deletion_count, MsgBlock&& piece)
+{
+  if (AI_UNLIKELY(!m_initialized))
+  {
+    // Let zlib detect gzip or zlib format from the header (see inflateInit2).
+    int ret = inflateInit2(&m_zstream, 15 + 32);
+    if (ret != Z_OK)
+      THROW_ALERT("inflateInit2 failed: [ERROR]", AIArgs("[ERROR]", m_zstream.msg ? m_zstream.msg : zError(ret)));
+    m_initialized = true;
+  }
+  int const prev_allow_deletion_count = allow_deletion_count;
+  m_zstream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(piece.get_start()));
+  m_zstream.avail_in = piece.get_size();
+  do
+  {
+    // More input after the end of a stream is the start of the next stream.
+    if (m_stream_end)
+    {
+      inflateReset(&m_zstream);
+      m_stream_end = false;
+    }
+    // We may only write to m_output_block when nobody else (still) holds a MsgBlock that refers to it.
+    if (!m_output_block || !m_output_block->unique().is_true())
+    {
+      if (m_output_block)
+        m_output_block->release();
+      m_output_block = MemoryBlock::create(utils::malloc_size(s_output_block_size + sizeof(MemoryBlock)) - sizeof(MemoryBlock));
+      AllocTag((void*)m_output_block, "InflateStage: memory block for inflated data");
+    }
+    m_zstream.next_out = reinterpret_cast<Bytef*>(m_output_block->block_start());
+    size_t const block_size = m_output_block->get_size();
+    m_zstream.avail_out = block_size;
+    int ret = ::inflate(&m_zstream, Z_NO_FLUSH);
+    if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+      THROW_ALERT("inflate failed: [ERROR]", AIArgs("[ERROR]", m_zstream.msg ? m_zstream.msg : zError(ret)));
+    size_t produced = block_size - m_zstream.avail_out;
+    if (produced > 0)
+    {
+      emit(allow_deletion_count, MsgBlock(m_output_block->block_start(), produced, m_output_block));
+      if (AI_UNLIKELY(allow_deletion_count > prev_allow_deletion_count))
+        break;
+    }
+    if (ret == Z_STREAM_END)
+      m_stream_end = true;
+    else if (ret == Z_BUF_ERROR || produced < block_size)
+      break;
+  }
+  while (m_zstream.avail_in > 0 || !m_stream_end);
+  // Nothing of piece is held: the input that wasn't inflated because the device was closed is dropped.
+  m_zstream.next_in = nullptr;
+  m_zstream.avail_in = 0;
+  set_buffered(0);
+}
+
+void InflateStage::end_of_stream(int& UNUSED_ARG(allow_deletion_count))
+{
+  // A stream that was cut off (for example because the connection was closed) must not be passed on as if it were complete.
+  if (m_initialized && !m_stream_end)
+    THROW_ALERT("Truncated deflate stream");
+}
+
+void RateLimitStage::transform(int& allow_deletion_count, MsgBlock&& piece)
+{
+  // Held data must stay valid.
+  ASSERT(piece.has_memory_block());
+  m_held_size += piece.get_size();
+  m_held.push_back(std::move(piece));
+  release(allow_deletion_count, false);
+}
+
+void RateLimitStage::end_of_stream(int& allow_deletion_count)
+{
+  release(allow_deletion_count, true);
+}
+
+void RateLimitStage::resumed(int& allow_deletion_count)
+{
+  release(allow_deletion_count, false);
+}
+
+// Pass on as much of the held data as the rate allows, or everything if all is set.
+void RateLimitStage::release(int& allow_deletion_count, bool all)
+{
+  clock_type::time_point now = clock_type::now();
+  m_allowance = std::min(m_burst, m_allowance + std::chrono::duration<double>(now - m_last_update).count() * m_bytes_per_second);
+  m_last_update = now;
+  int const prev_allow_deletion_count = allow_deletion_count;
+  while (!m_held.empty() && (all || m_allowance >= 1.0))
+  {
+    size_t len = m_held.front().get_size();
+    if (!all)
+      len = std::min(len, static_cast<size_t>(m_allowance));
+    MsgBlock piece = m_held.front().slice({m_held.front().get_start(), len});
+    m_held.front().remove_prefix(len);
+    if (m_held.front().get_size() == 0)
+      m_held.pop_front();
+    m_held_size -= len;
+    if (!all)
+      m_allowance -= len;
+    emit(allow_deletion_count, std::move(piece));
+    if (AI_UNLIKELY(allow_deletion_count > prev_allow_deletion_count))
+      break;
+  }
+  set_buffered(m_held_size);
+}
+
+} // namespace protocol
+} // namespace evio
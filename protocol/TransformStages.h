@@ -0,0 +1,86 @@
+#pragma once
+
+#include "TransformChain.h"
+#include <zlib.h>
+#include <chrono>
+#include <deque>
+#include <functional>
+
+namespace evio {
+namespace protocol {
+
+// Passes everything on unchanged, after showing it to a callback (for example to log or count the traffic).
+class TapStage : public TransformStage
+{
+ public:
+  using tap_type = std::function<void(MsgBlock const&)>;
+
+ private:
+  tap_type m_tap;
+
+ public:
+  TapStage(tap_type tap) : m_tap(std::move(tap)) { }
+
+ protected:
+  void transform(int& allow_deletion_count, MsgBlock&& piece) override
+  {
+    m_tap(piece);
+    emit(allow_deletion_count, std::move(piece));
+  }
+};
+
+// Inflates a gzip or zlib stream (detected from its header), into MemoryBlocks of at most s_output_block_size bytes.
+// Concatenated streams (multiple gzip members) are inflated one after another.
+class InflateStage : public TransformStage
+{
+ public:
+  static constexpr size_t s_output_block_size = 16384;
+
+ private:
+  z_stream m_zstream;
+  bool m_initialized;                   // Set when inflateInit2 was called successfully.
+  bool m_stream_end;                    // Set when the end of a stream was reached.
+  MemoryBlock* m_output_block;          // The block that inflate writes to.
+
+ public:
+  InflateStage() : m_zstream{}, m_initialized(false), m_stream_end(false), m_output_block(nullptr) { }
+  ~InflateStage();
+
+ protected:
+  void transform(int& allow_deletion_count, MsgBlock&& piece) override;
+  void end_of_stream(int& allow_deletion_count) override;
+};
+
+// Passes the data on at no more than a given number of bytes per second.
+//
+// Data that exceeds the rate is held (without copying it) until resume() is called,
+// which must be done periodically, for example every 10 ms from a timer, as long as
+// buffered() is non-zero. Holding more than the high watermark stops the input device.
+class RateLimitStage : public TransformStage
+{
+ private:
+  using clock_type = std::chrono::steady_clock;
+
+  double const m_bytes_per_second;
+  double const m_burst;                 // The maximum number of bytes that can be passed on at once.
+  double m_allowance;                   // The number of bytes that can be passed on now.
+  clock_type::time_point m_last_update;
+  std::deque<MsgBlock> m_held;          // The data that still has to be passed on.
+  size_t m_held_size;                   // The total size of m_held.
+
+ public:
+  RateLimitStage(size_t bytes_per_second, size_t burst, size_t high_watermark = 256 * 1024, size_t low_watermark = 64 * 1024) :
+    TransformStage(high_watermark, low_watermark), m_bytes_per_second(bytes_per_second), m_burst(burst), m_allowance(burst),
+    m_last_update(clock_type::now()), m_held_size(0) { }
+
+ protected:
+  void transform(int& allow_deletion_count, MsgBlock&& piece) override;
+  void end_of_stream(int& allow_deletion_count) override;
+  void resumed(int& allow_deletion_count) override;
+
+ private:
+  void release(int& allow_deletion_count, bool all);
+};
+
+} // namespace protocol
+} // namespace evio
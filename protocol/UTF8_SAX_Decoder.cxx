@@ -1,18 +1,245 @@
 #include "sys.h"
 #include "UTF8_SAX_Decoder.h"
 #include "debug.h"
+#include <charconv>
+#include <cstdint>
 #include <cstring>
 #include <iostream>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace evio {
 namespace protocol {
 
+namespace {
+
+// The character classes of 64 consecutive bytes; bit i corresponds to byte i.
+struct CharacterClasses
+{
+  uint64_t m_angle_brackets;            // '<' or '>'.
+  uint64_t m_whitespace;                // ' ', '\t', '\n' or '\r' (the S production of XML).
+};
+
+inline bool is_xml_whitespace(char c)
+{
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+CharacterClasses classify(char const* block)
+{
+  CharacterClasses result = { 0, 0 };
+#ifdef __SSE2__
+  __m128i const lt = _mm_set1_epi8('<');
+  __m128i const gt = _mm_set1_epi8('>');
+  __m128i const space = _mm_set1_epi8(' ');
+  __m128i const tab = _mm_set1_epi8('\t');
+  __m128i const lf = _mm_set1_epi8('\n');
+  __m128i const cr = _mm_set1_epi8('\r');
+  for (int i = 0; i < 64; i += 16)
+  {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(block + i));
+    uint64_t angle_brackets = static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, lt), _mm_cmpeq_epi8(v, gt))));
+    uint64_t whitespace = static_cast<uint32_t>(_mm_movemask_epi8(
+          _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)),
+                       _mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, cr)))));
+    result.m_angle_brackets |= angle_brackets << i;
+    result.m_whitespace |= whitespace << i;
+  }
+#else
+  for (int i = 0; i < 64; ++i)
+  {
+    result.m_angle_brackets |= static_cast<uint64_t>(block[i] == '<' || block[i] == '>') << i;
+    result.m_whitespace |= static_cast<uint64_t>(is_xml_whitespace(block[i])) << i;
+  }
+#endif
+  return result;
+}
+
+// Finds angle brackets and the end of whitespace in [begin, end), using the character classes of one 64 byte block at a time.
+class Scanner
+{
+ private:
+  char const* const m_begin;
+  char const* const m_end;
+  char const* m_block;                  // The start of the block that m_classes belongs to.
+  CharacterClasses m_classes;
+
+  void load(char const* ptr)
+  {
+    m_block = m_begin + ((ptr - m_begin) & ~size_t{63});
+    if (AI_LIKELY(m_end - m_block >= 64))
+      m_classes = classify(m_block);
+    else
+    {
+      // The last block is classified from a copy, so that we don't read beyond m_end.
+      // Bytes beyond m_end become zeroes: neither angle brackets nor whitespace.
+      char tail[64] = {};
+      std::memcpy(tail, m_block, m_end - m_block);
+      m_classes = classify(tail);
+    }
+  }
+
+  template<uint64_t CharacterClasses::* classes, bool invert>
+  char const* find(char const* ptr)
+  {
+    while (ptr < m_end)
+    {
+      if (ptr - m_block >= 64 || ptr < m_block)
+        load(ptr);
+      uint64_t bits = m_classes.*classes;
+      if (invert)
+        bits = ~bits;
+      bits &= ~uint64_t{0} << (ptr - m_block);
+      if (bits)
+        return std::min(m_block + __builtin_ctzll(bits), m_end);
+      ptr = m_block + 64;
+    }
+    return m_end;
+  }
+
+ public:
+  Scanner(char const* begin, char const* end) : m_begin(begin), m_end(end), m_block(begin) { load(begin); }
+
+  // Return the first '<' or '>' at or after ptr, or end.
+  char const* find_angle_bracket(char const* ptr) { return find<&CharacterClasses::m_angle_brackets, false>(ptr); }
+
+  // Return the first non-whitespace character at or after ptr, or end.
+  char const* skip_whitespace(char const* ptr) { return find<&CharacterClasses::m_whitespace, true>(ptr); }
+};
+
+// Bits returned by scan_characters.
+constexpr unsigned has_non_ascii = 1;
+constexpr unsigned has_ampersand = 2;
+
+// Return which of has_non_ascii and has_ampersand apply to [ptr, end).
+unsigned scan_characters(char const* ptr, char const* end)
+{
+  unsigned result = 0;
+#ifdef __SSE2__
+  __m128i const ampersand = _mm_set1_epi8('&');
+  for (; end - ptr >= 16; ptr += 16)
+  {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(ptr));
+    // The sign bit of each byte is set for non-ASCII bytes.
+    if (_mm_movemask_epi8(v))
+      result |= has_non_ascii;
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, ampersand)))
+      result |= has_ampersand;
+  }
+#endif
+  for (; ptr < end; ++ptr)
+  {
+    if (static_cast<unsigned char>(*ptr) >= 0x80)
+      result |= has_non_ascii;
+    else if (*ptr == '&')
+      result |= has_ampersand;
+  }
+  return result;
+}
+
+// Return the first non-ASCII byte at or after ptr, or end.
+char const* skip_ascii(char const* ptr, char const* end)
+{
+#ifdef __SSE2__
+  for (; end - ptr >= 16; ptr += 16)
+  {
+    int non_ascii = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const*>(ptr)));
+    if (non_ascii)
+      return ptr + __builtin_ctz(non_ascii);
+  }
+#endif
+  while (ptr < end && static_cast<unsigned char>(*ptr) < 0x80)
+    ++ptr;
+  return ptr;
+}
+
+// Throw if [ptr, end) is not valid UTF-8 (RFC3629): no overlong encodings, surrogates or code points beyond U+10FFFF.
+void validate_utf8(char const* ptr, char const* end)
+{
+  for (;;)
+  {
+    ptr = skip_ascii(ptr, end);
+    if (ptr == end)
+      return;
+    unsigned char const* p = reinterpret_cast<unsigned char const*>(ptr);
+    size_t const available = end - ptr;
+    // The valid ranges of the second byte depend on the first byte (RFC3629, section 4).
+    size_t len;
+    unsigned char min = 0x80;
+    unsigned char max = 0xbf;
+    if (p[0] >= 0xc2 && p[0] <= 0xdf)
+      len = 2;
+    else if (p[0] >= 0xe0 && p[0] <= 0xef)
+    {
+      len = 3;
+      if (p[0] == 0xe0)
+        min = 0xa0;                     // Overlong.
+      else if (p[0] == 0xed)
+        max = 0x9f;                     // Surrogates.
+    }
+    else if (p[0] >= 0xf0 && p[0] <= 0xf4)
+    {
+      len = 4;
+      if (p[0] == 0xf0)
+        min = 0x90;                     // Overlong.
+      else if (p[0] == 0xf4)
+        max = 0x8f;                     // Beyond U+10FFFF.
+    }
+    else
+      THROW_ALERT("Invalid UTF-8 lead byte");
+    if (available < len || p[1] < min || p[1] > max)
+      THROW_ALERT("Invalid UTF-8 sequence");
+    for (size_t i = 2; i < len; ++i)
+      if ((p[i] & 0xc0) != 0x80)
+        THROW_ALERT("Invalid UTF-8 sequence");
+    ptr += len;
+  }
+}
+
+// Append the UTF-8 encoding of code_point to out.
+void append_utf8(std::string& out, uint32_t code_point)
+{
+  if (code_point < 0x80)
+    out += static_cast<char>(code_point);
+  else if (code_point < 0x800)
+  {
+    out += static_cast<char>(0xc0 | (code_point >> 6));
+    out += static_cast<char>(0x80 | (code_point & 0x3f));
+  }
+  else if (code_point < 0x10000)
+  {
+    out += static_cast<char>(0xe0 | (code_point >> 12));
+    out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3f));
+    out += static_cast<char>(0x80 | (code_point & 0x3f));
+  }
+  else
+  {
+    out += static_cast<char>(0xf0 | (code_point >> 18));
+    out += static_cast<char>(0x80 | ((code_point >> 12) & 0x3f));
+    out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3f));
+    out += static_cast<char>(0x80 | (code_point & 0x3f));
+  }
+}
+
+// The Char production of XML 1.0.
+inline bool is_xml_char(uint32_t code_point)
+{
+  return code_point == 0x9 || code_point == 0xa || code_point == 0xd ||
+         (code_point >= 0x20 && code_point <= 0xd7ff) ||
+         (code_point >= 0xe000 && code_point <= 0xfffd) ||
+         (code_point >= 0x10000 && code_point <= 0x10ffff);
+}
+
+} // namespace
+
 size_t UTF8_SAX_Decoder::end_of_msg_finder(char const* new_data, size_t rlen, evio::EndOfMsgFinderResult& UNUSED_ARG(result))
 {
   DoutEntering(dc::endofmsg|continued_cf, "UTF8_SAX_Decoder::end_of_msg_finder(..., " << rlen << ") = ");
   // ASCII bytes (< 128) do not occur when encoding non-ASCII code points into UTF-8 (all extension bytes are >= 128).
   // It is therefore safe to simply search byte for byte for a '>'.
-  char const* right_angle_bracket = static_cast<char const*>(memchr(new_data, '>', rlen));
+  // Decode everything up to the last one; the rest will be decoded together with the next data.
+  char const* right_angle_bracket = static_cast<char const*>(memrchr(new_data, '>', rlen));
   size_t found_len = right_angle_bracket ? right_angle_bracket - new_data + 1 : 0;
   Dout(dc::finish, found_len);
   return found_len;
@@ -21,91 +248,175 @@ size_t UTF8_SAX_Decoder::end_of_msg_finder(char const* new_data, size_t rlen, ev
 UTF8_SAX_Decoder::index_type UTF8_SAX_Decoder::get_element_id(std::string_view name)
 {
   // The name passed might still end on zero or more spaces.
-  while (name.back() == ' ')
-  {
+  while (!name.empty() && name.back() == ' ')
     name.remove_suffix(1);
-    if (name.empty())
-      THROW_FALERT("Empty name");
-  }
-  return m_dictionary.index(name);
+  if (name.empty())
+    THROW_FALERT("Empty name");
+  NameCacheEntry& entry = m_name_cache[name_cache_slot(name)];
+  if (AI_LIKELY(entry.m_name == name))
+    return entry.m_element_id;
+  index_type element_id = m_dictionary.index(name);
+  entry.m_name = name;
+  entry.m_element_id = element_id;
+  return element_id;
 }
 
 void UTF8_SAX_Decoder::decode(int& allow_deletion_count, evio::MsgBlock&& msg)
 {
   DoutEntering(dc::decoder, "UTF8_SAX_Decoder::decode({" << allow_deletion_count << "}, " <<  msg << ")");
 
-  // Allow newlines and indentation...
-  size_t leading_number_of_WS = 0;
-  char const* data = msg.get_start();
-  while (std::isspace(data[leading_number_of_WS]))
-    ++leading_number_of_WS;
-  msg.remove_prefix(leading_number_of_WS);
-
-  data = msg.get_start();
-  size_t const len = msg.get_size();
+  char const* ptr = msg.get_start();
+  char const* const end = msg.get_end();
 
   // decode should never be called with an empty msg.
-  ASSERT(len > 0);
+  ASSERT(ptr != end);
+  // end_of_msg_finder only returns data that ends on a '>'.
+  ASSERT(end[-1] == '>');
 
-  using ParseError = std::exception;
+  Scanner scanner(ptr, end);
+  char const* token = ptr;
   try
   {
-    if (data[0] == '<')
+    for (;;)
     {
-      // The minimum message is "<n>".
-      if (len < 3)
-        throw ParseError{};
-      if (m_document_begin)
-      {
-        m_document_begin = false;
-        // <?xml version="1.0" encoding="utf-8"?>
-        if (len < 8 || strncmp(data, "<?xml ", 6) != 0 || strncmp(data + len - 2, "?>", 2) != 0)
-          throw ParseError{};
-        char const* attributes = data + 6;
-        while (*attributes == ' ')
-          ++attributes;
-        // FIXME
-        std::string version;
-        std::string encoding;
-        start_document(m_content_length, version, encoding);
-        return;
-      }
-      if (data[1] == '/')
+      // Allow newlines and indentation...
+      token = ptr = scanner.skip_whitespace(ptr);
+      if (ptr == end)
+        break;
+      if (*ptr != '<')
       {
-        // </n>
-        end_element(get_element_id({&data[2], len - 3}));
+        // Character data must be followed by an end tag.
+        char const* left_angle_bracket = scanner.find_angle_bracket(ptr);
+        // Because msg ends on a '>' there is always a character after a '<'.
+        if (AI_UNLIKELY(*left_angle_bracket != '<' || left_angle_bracket[1] != '/'))
+          THROW_ALERT("Expected end tag after character data");
+        m_msg = &msg;
+        m_raw_characters = {ptr, static_cast<size_t>(left_angle_bracket - ptr)};
+        characters(decode_characters(m_raw_characters));
+        m_msg = nullptr;
+        m_raw_characters = {};
+        token = ptr = left_angle_bracket;
       }
-      else
+      char const* right_angle_bracket = scanner.find_angle_bracket(ptr + 1);
+      if (AI_UNLIKELY(right_angle_bracket == end || *right_angle_bracket != '>'))
+        THROW_ALERT("Unexpected '<' in tag");
+      decode_tag(ptr, right_angle_bracket + 1 - ptr);
+      ptr = right_angle_bracket + 1;
+    }
+  }
+  catch (AIAlert::Error const& error)
+  {
+    // Only print the first tag (or character data) that could not be decoded.
+    char const* token_end = std::min(scanner.find_angle_bracket(token + 1) + 1, end);
+    THROW_FALERT("XML parse error decoding [DATA]", AIArgs("[DATA]", std::string_view(token, token_end - token)), error);
+  }
+}
+
+std::string_view UTF8_SAX_Decoder::decode_characters(std::string_view data)
+{
+  unsigned found = scan_characters(data.data(), data.data() + data.size());
+  if (AI_UNLIKELY(found & has_non_ascii))
+    validate_utf8(data.data(), data.data() + data.size());
+  if (AI_LIKELY(!(found & has_ampersand)))
+    return data;
+  return unescape(data);
+}
+
+evio::MsgBlock UTF8_SAX_Decoder::raw_characters_block() const
+{
+  // Called outside of characters().
+  if (!m_msg)
+    return std::string_view{};
+  return m_msg->slice(m_raw_characters);
+}
+
+std::string_view UTF8_SAX_Decoder::unescape(std::string_view data)
+{
+  // Clearing keeps the capacity, so that after a while no allocations are needed anymore.
+  m_unescaped.clear();
+  append_unescaped(data, m_unescaped);
+  return m_unescaped;
+}
+
+//static
+void UTF8_SAX_Decoder::append_unescaped(std::string_view data, std::string& out)
+{
+  size_t pos = 0;
+  for (;;)
+  {
+    size_t ampersand = data.find('&', pos);
+    out.append(data, pos, ampersand - pos);
+    if (ampersand == std::string_view::npos)
+      break;
+    size_t semicolon = data.find(';', ampersand + 1);
+    if (semicolon == std::string_view::npos)
+      THROW_ALERT("Unterminated reference");
+    std::string_view name = data.substr(ampersand + 1, semicolon - ampersand - 1);
+    if (!name.empty() && name[0] == '#')
+    {
+      // &#N; or &#xN;
+      int base = 10;
+      name.remove_prefix(1);
+      if (!name.empty() && name[0] == 'x')
       {
-        // <n> or <n/>.
-        bool empty_tag = data[len - 2] == '/';
-        index_type element_id = get_element_id({&data[1], len - (empty_tag ? 3 : 2)});
-        start_element(element_id);
-        if (empty_tag)
-          end_element(element_id);
+        base = 16;
+        name.remove_prefix(1);
       }
+      uint32_t code_point;
+      auto [end, ec] = std::from_chars(name.data(), name.data() + name.size(), code_point, base);
+      if (name.empty() || ec != std::errc() || end != name.data() + name.size() || !is_xml_char(code_point))
+        THROW_ALERT("Invalid character reference &#[NAME];", AIArgs("[NAME]", name));
+      append_utf8(out, code_point);
     }
+    else if (name == "amp")
+      out += '&';
+    else if (name == "lt")
+      out += '<';
+    else if (name == "gt")
+      out += '>';
+    else if (name == "quot")
+      out += '"';
+    else if (name == "apos")
+      out += '\'';
     else
-    {
-      char const* left_angle_bracket = static_cast<char const*>(memchr(data, '<', len));
-      size_t end_tag_length;
-      if (AI_UNLIKELY(!left_angle_bracket ||
-          (end_tag_length = len - (left_angle_bracket - data)) < 4 ||
-          left_angle_bracket[1] != '/'))        // 4 is the length of the minimal size of the end element: </n>.
-        throw ParseError{};
-      size_t characters_len = left_angle_bracket - data;
-      characters({data, characters_len});
-      // </n>
-      end_element(get_element_id({&left_angle_bracket[2], end_tag_length - 3}));
-    }
+      THROW_ALERT("Unknown entity &[NAME];", AIArgs("[NAME]", name));
+    pos = semicolon + 1;
   }
-  catch (AIAlert::Error const& error)
+}
+
+void UTF8_SAX_Decoder::decode_tag(char const* data, size_t len)
+{
+  // The minimum tag is "<n>".
+  if (len < 3)
+    THROW_ALERT("Tag too short");
+  if (m_document_begin)
+  {
+    m_document_begin = false;
+    // <?xml version="1.0" encoding="utf-8"?>
+    if (len < 8 || strncmp(data, "<?xml ", 6) != 0 || strncmp(data + len - 2, "?>", 2) != 0)
+      THROW_ALERT("Expected XML declaration");
+    char const* attributes = data + 6;
+    while (*attributes == ' ')
+      ++attributes;
+    // FIXME
+    std::string version;
+    std::string encoding;
+    start_document(m_content_length, version, encoding);
+    return;
+  }
+  if (data[1] == '/')
   {
-    THROW_FALERT("XML parse error decoding [DATA]", AIArgs("[DATA]", msg), error);
+    // </n>
+    end_element(get_element_id({&data[2], len - 3}));
   }
-  catch (ParseError const&)
+  else
   {
-    THROW_FALERT("XML parse error decoding [DATA]", AIArgs("[DATA]", msg));
+    // <n> or <n/>.
+    bool empty_tag = data[len - 2] == '/';
+    index_type element_id = get_element_id({&data[1], len - (empty_tag ? 3 : 2)});
+    start_element(element_id);
+    if (empty_tag)
+      end_element(element_id);
   }
 }
 
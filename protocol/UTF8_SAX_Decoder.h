@@ -2,7 +2,9 @@
 
 #include "evio/protocol/Decoder.h"
 #include "utils/Dictionary.h"
+#include <array>
 #include <unordered_map>
+#include <string>
 #include <string_view>
 #include <iosfwd>
 
@@ -13,6 +15,19 @@ namespace protocol {
 //
 // It only supports UTF-8.
 //
+// end_of_msg_finder returns everything up to and including the last '>' of the
+// received data, so that decode is called once per read instead of once per tag.
+// decode then classifies the characters of the whole block, 64 bytes at a time,
+// and emits all start_element, characters and end_element events in a single pass.
+// Element names are looked up in a small direct mapped cache before using the dictionary.
+//
+// Character data is checked to be valid UTF-8 and references (&amp;, &lt;, &#233;,
+// &#xE9; etc) are replaced before it is passed to characters(). When there is
+// nothing to replace, which is the common case, the view points into the input
+// buffer; otherwise into a buffer of the decoder. Either way it is only valid
+// until characters() returns; raw_characters_block() can be used to keep the
+// received data.
+//
 class UTF8_SAX_Decoder : public Decoder
 {
  public:
@@ -20,21 +35,54 @@ class UTF8_SAX_Decoder : public Decoder
   using enum_type = size_t;
 
  private:
+  struct NameCacheEntry
+  {
+    std::string m_name;                 // Empty if unused.
+    index_type m_element_id;
+  };
+  static constexpr size_t s_name_cache_size = 64;
+
   bool m_document_begin;
   utils::Dictionary<enum_type, index_type> m_dictionary;
+  std::array<NameCacheEntry, s_name_cache_size> m_name_cache;
+  std::string m_unescaped;              // Reused for character data that contains references.
+  evio::MsgBlock const* m_msg;          // The block being decoded.
+  std::string_view m_raw_characters;    // The character data passed to characters(), before replacing references.
 
  public:
-  UTF8_SAX_Decoder() : m_document_begin(true) { }
+  UTF8_SAX_Decoder() : m_document_begin(true), m_msg(nullptr) { }
+
+  // Append data, with its references replaced, to out.
+  static void append_unescaped(std::string_view data, std::string& out);
+
+  // Only valid during a call to characters(): the character data as received
+  // (before references were replaced), and a MsgBlock of it that keeps the
+  // receive buffer alive (if the data is in one).
+  std::string_view raw_characters() const { return m_raw_characters; }
+  evio::MsgBlock raw_characters_block() const;
 
  private:
+  // Cheap, and different for all XML-RPC element names.
+  static size_t name_cache_slot(std::string_view name)
+  {
+    return (static_cast<unsigned char>(name.front()) + 6 * static_cast<unsigned char>(name.back()) + 3 * name.size()) % s_name_cache_size;
+  }
+
   index_type get_element_id(std::string_view name);
+  void decode_tag(char const* data, size_t len);
+  std::string_view decode_characters(std::string_view data);
+  std::string_view unescape(std::string_view data);
 
  protected:
   void add(enum_type element_id, std::string&& element_name)
   {
     m_dictionary.add(element_id, element_name);
+    for (NameCacheEntry& entry : m_name_cache)
+      entry.m_name.clear();
   }
   size_t end_of_msg_finder(char const* new_data, size_t rlen, evio::EndOfMsgFinderResult& result) final;
+  // end_of_msg_finder only searches for the last '>'; it can run while decode is running (see AsyncDecoder).
+  bool has_stateless_end_of_msg_finder() const final { return true; }
   void decode(int& allow_deletion_count, evio::MsgBlock&& msg) override;
   void end_of_content(int& allow_deletion_count) override;
 
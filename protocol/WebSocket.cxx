@@ -0,0 +1,321 @@
+#include "sys.h"
+#include "WebSocket.h"
+#include "http.h"
+#include "evio/BinaryData.h"
+#include <wolfssl/options.h>
+#include <wolfssl/wolfcrypt/sha.h>
+#include <cstring>
+#include <strings.h>
+#include <ostream>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef CWDEBUG
+#include "utils/debug_ostream_operators.h"
+#endif
+
+namespace evio {
+namespace protocol {
+namespace websocket {
+
+void apply_mask(char* data, size_t len, char const masking_key[4], size_t offset)
+{
+  // The key, rotated such that it starts at data.
+  char key[16];
+  for (int i = 0; i < 16; ++i)
+    key[i] = masking_key[(offset + i) & 3];
+  size_t i = 0;
+#ifdef __SSE2__
+  __m128i const mask = _mm_loadu_si128(reinterpret_cast<__m128i const*>(key));
+  for (; i + 16 <= len; i += 16)
+  {
+    __m128i d = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_xor_si128(d, mask));
+  }
+#else
+  uint64_t mask;
+  std::memcpy(&mask, key, sizeof(mask));
+  for (; i + 8 <= len; i += 8)
+  {
+    uint64_t d;
+    std::memcpy(&d, data + i, sizeof(d));
+    d ^= mask;
+    std::memcpy(data + i, &d, sizeof(d));
+  }
+#endif
+  // Both loops above advance i by a multiple of four, so key[i & 3] is still in phase.
+  for (; i < len; ++i)
+    data[i] ^= key[i & 3];
+}
+
+std::string Message::to_string() const
+{
+  std::string result;
+  result.reserve(m_size);
+  for (auto&& segment : m_segments)
+    result.append(segment.get_start(), segment.get_size());
+  return result;
+}
+
+size_t FrameDecoder::end_of_msg_finder(char const* new_data, size_t rlen, EndOfMsgFinderResult& UNUSED_ARG(result))
+{
+  DoutEntering(dc::endofmsg, "websocket::FrameDecoder::end_of_msg_finder(..., " << rlen << ")");
+  // Pass payload data on as soon as it is received, even if that is only part of the frame.
+  if (m_state == payload_data)
+    return std::min(static_cast<uint64_t>(rlen), m_payload_remaining);
+  // Find the end of the frame header. Its length follows from the second byte.
+  for (size_t i = 0; i < rlen; ++i)
+  {
+    if (m_header_seen == 1)
+    {
+      uint8_t b1 = new_data[i];
+      uint8_t payload_len = b1 & 0x7f;
+      m_header_length = 2 + (payload_len == 126 ? 2 : payload_len == 127 ? 8 : 0) + ((b1 & 0x80) ? 4 : 0);
+    }
+    if (++m_header_seen == m_header_length)
+    {
+      m_header_seen = 0;
+      m_header_length = 2;
+      return i + 1;
+    }
+  }
+  return 0;
+}
+
+void FrameDecoder::decode_frame_header(MsgBlock const& msg)
+{
+  //  0                   1                   2                   3
+  //  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+  // +-+-+-+-+-------+-+-------------+-------------------------------+
+  // |F|R|R|R| opcode|M| Payload len |    Extended payload length    |
+  // |I|S|S|S|  (4)  |A|     (7)     |             (16/64)           |
+  // |N|V|V|V|       |S|             |   (if payload len==126/127)   |
+  // | |1|2|3|       |K|             |                               |
+  // +-+-+-+-+-------+-+-------------+ - - - - - - - - - - - - - - - +
+  // ... masking-key (0 or 4 bytes), payload data.
+  uint8_t const* ptr = reinterpret_cast<uint8_t const*>(msg.get_start());
+  m_fin = ptr[0] & 0x80;
+  if (ptr[0] & 0x70)
+    THROW_ALERT("Received frame with RSV bits set, but no extension was negotiated");
+  opcode_t opcode = static_cast<opcode_t>(ptr[0] & 0x0f);
+  m_masked = ptr[1] & 0x80;
+  uint64_t payload_len = ptr[1] & 0x7f;
+  ptr += 2;
+  if (payload_len == 126)
+  {
+    payload_len = (uint64_t{ptr[0]} << 8) | ptr[1];
+    ptr += 2;
+  }
+  else if (payload_len == 127)
+  {
+    payload_len = 0;
+    for (int i = 0; i < 8; ++i)
+      payload_len = (payload_len << 8) | ptr[i];
+    ptr += 8;
+  }
+  if (m_masked)
+    std::memcpy(m_masking_key, ptr, 4);
+  Dout(dc::decoder, "opcode = " << (int)opcode << "; FIN = " << m_fin << "; MASK = " << m_masked << "; payload length = " << payload_len);
+
+  if (m_masked != m_server_side)
+    THROW_ALERT(m_server_side ? "Received unmasked frame from client" : "Received masked frame from server");
+  if (opcode & 0x8)
+  {
+    // Control frames may be interleaved with the fragments of a message, but are never fragmented themselves.
+    if (opcode != op_close && opcode != op_ping && opcode != op_pong)
+      THROW_ALERT("Received frame with reserved opcode [OPCODE]", AIArgs("[OPCODE]", (int)opcode));
+    if (!m_fin || payload_len > 125)
+      THROW_ALERT("Received invalid control frame");
+    m_control_frame.start(opcode);
+    m_current = &m_control_frame;
+  }
+  else
+  {
+    if (opcode == op_continuation)
+    {
+      if (!m_message_in_progress)
+        THROW_ALERT("Received continuation frame without a message to continue");
+    }
+    else if (opcode != op_text && opcode != op_binary)
+      THROW_ALERT("Received frame with reserved opcode [OPCODE]", AIArgs("[OPCODE]", (int)opcode));
+    else if (m_message_in_progress)
+      THROW_ALERT("Received new data frame while the previous message was not finished");
+    else
+      m_message.start(opcode);
+    if (payload_len > m_max_message_size - m_message.size())
+      THROW_ALERT("Message exceeds [MAX] bytes", AIArgs("[MAX]", m_max_message_size));
+    m_message_in_progress = !m_fin;
+    m_current = &m_message;
+  }
+  m_payload_remaining = payload_len;
+  m_mask_offset = 0;
+}
+
+void FrameDecoder::decode(int& allow_deletion_count, MsgBlock&& msg)
+{
+  DoutEntering(dc::decoder, "websocket::FrameDecoder::decode({" << allow_deletion_count << "}, " << msg << ") [" << this << ']');
+  try
+  {
+    if (m_state == frame_header)
+    {
+      decode_frame_header(msg);
+      if (m_payload_remaining == 0)
+        end_of_frame(allow_deletion_count);
+      else
+        m_state = payload_data;
+      return;
+    }
+    m_payload_remaining -= msg.get_size();
+    if (m_masked)
+    {
+      // This part of the input buffer is ours: unmask it in place.
+      apply_mask(const_cast<char*>(msg.get_start()), msg.get_size(), m_masking_key, m_mask_offset);
+      m_mask_offset += msg.get_size();
+    }
+    m_current->append(std::move(msg));
+    if (m_payload_remaining == 0)
+    {
+      m_state = frame_header;
+      end_of_frame(allow_deletion_count);
+    }
+  }
+  catch (AIAlert::Error const& error)
+  {
+    Dout(dc::warning, error << " caught in WebSocket.cxx");
+    close_input_device(allow_deletion_count);
+  }
+}
+
+void FrameDecoder::end_of_frame(int& allow_deletion_count)
+{
+  if (m_current == &m_control_frame)
+  {
+    control_frame_received(allow_deletion_count, std::move(m_control_frame));
+    m_control_frame.clear();
+  }
+  else if (m_fin)
+  {
+    message_received(allow_deletion_count, std::move(m_message));
+    m_message.clear();
+  }
+}
+
+void FrameDecoder::control_frame_received(int& allow_deletion_count, Message&& control_frame)
+{
+  if (control_frame.opcode() == op_close)
+    close_input_device(allow_deletion_count);
+}
+
+void FrameEncoder::write_frame(opcode_t opcode, std::string_view payload, bool fin)
+{
+  char header[14];
+  size_t header_length = 2;
+  header[0] = (fin ? 0x80 : 0) | opcode;
+  uint8_t const mask_bit = m_mask ? 0x80 : 0;
+  uint64_t const payload_len = payload.size();
+  if (payload_len < 126)
+    header[1] = mask_bit | payload_len;
+  else if (payload_len <= 0xffff)
+  {
+    header[1] = mask_bit | 126;
+    header[2] = payload_len >> 8;
+    header[3] = payload_len;
+    header_length = 4;
+  }
+  else
+  {
+    header[1] = mask_bit | 127;
+    for (int i = 0; i < 8; ++i)
+      header[2 + i] = payload_len >> (56 - 8 * i);
+    header_length = 10;
+  }
+  if (!m_mask)
+  {
+    m_output.write(header, header_length);
+    m_output.write(payload.data(), payload.size());
+    return;
+  }
+  uint32_t key = m_masking_key_generator();
+  char* masking_key = header + header_length;
+  std::memcpy(masking_key, &key, 4);
+  header_length += 4;
+  m_output.write(header, header_length);
+  // Mask a copy of the payload, in pieces.
+  char buf[4096];
+  for (size_t offset = 0; offset < payload.size(); offset += sizeof(buf))
+  {
+    size_t len = std::min(sizeof(buf), payload.size() - offset);
+    std::memcpy(buf, payload.data() + offset, len);
+    apply_mask(buf, len, masking_key, offset);
+    m_output.write(buf, len);
+  }
+}
+
+void FrameEncoder::write_close(uint16_t status_code, std::string_view reason)
+{
+  // The payload of a close frame is the status code in network byte order, followed by the reason.
+  char payload[125];
+  payload[0] = status_code >> 8;
+  payload[1] = status_code;
+  size_t len = std::min(reason.size(), sizeof(payload) - 2);
+  std::memcpy(payload + 2, reason.data(), len);
+  write_frame(op_close, { payload, 2 + len });
+}
+
+std::string accept_key(std::string_view sec_websocket_key)
+{
+  static constexpr std::string_view guid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+  std::string concatenated{sec_websocket_key};
+  concatenated += guid;
+  unsigned char digest[WC_SHA_DIGEST_SIZE];
+  wc_Sha sha;
+  wc_InitSha(&sha);
+  wc_ShaUpdate(&sha, reinterpret_cast<unsigned char const*>(concatenated.data()), concatenated.size());
+  wc_ShaFinal(&sha, digest);
+  wc_ShaFree(&sha);
+  BinaryData binary_data;
+  binary_data.assign_from_binary({ reinterpret_cast<char const*>(digest), sizeof(digest) });
+  return binary_data.to_base64_string();
+}
+
+ClientHandshake::ClientHandshake()
+{
+  // The key is a randomly selected 16-byte value, base64 encoded.
+  std::random_device random_device;
+  char nonce[16];
+  for (size_t i = 0; i < sizeof(nonce); i += 4)
+  {
+    uint32_t r = random_device();
+    std::memcpy(nonce + i, &r, 4);
+  }
+  BinaryData binary_data;
+  binary_data.assign_from_binary({ nonce, sizeof(nonce) });
+  m_key = binary_data.to_base64_string();
+}
+
+void ClientHandshake::write_request(std::ostream& output, std::string_view host, std::string_view request_target, std::string_view protocols) const
+{
+  output << "GET " << request_target << " HTTP/1.1\r\n"
+            "Host: " << host << "\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: Upgrade\r\n"
+            "Sec-WebSocket-Key: " << m_key << "\r\n"
+            "Sec-WebSocket-Version: 13\r\n";
+  if (!protocols.empty())
+    output << "Sec-WebSocket-Protocol: " << protocols << "\r\n";
+  output << "\r\n";
+}
+
+bool ClientHandshake::verify(http::ResponseHeadersDecoder const& response) const
+{
+  if (response.get_status_code() != 101)
+    return false;
+  http::HeaderField const* upgrade = response.find_header(http::hf_upgrade);
+  http::HeaderField const* accept = response.find_header(http::hf_sec_websocket_accept);
+  return upgrade && upgrade->m_value.size() == 9 && strncasecmp(upgrade->m_value.data(), "websocket", 9) == 0 &&
+         accept && accept->m_value == accept_key(m_key);
+}
+
+} // namespace websocket
+} // namespace protocol
+} // namespace evio
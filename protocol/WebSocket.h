@@ -0,0 +1,165 @@
+#pragma once
+
+#include "Decoder.h"
+#include <cstdint>
+#include <iosfwd>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace evio {
+namespace protocol {
+namespace http {
+class ResponseHeadersDecoder;
+} // namespace http
+
+namespace websocket {
+
+// The WebSocket protocol (RFC6455).
+//
+// A connection is upgraded from HTTP by sending a request written with
+// ClientHandshake::write_request and calling
+//
+//   http_decoder.expect_upgrade([&](http::ResponseHeadersDecoder const& response){ return handshake.verify(response); }, frame_decoder);
+//
+// after which the input device switches to frame_decoder when the
+// "101 Switching Protocols" response was received.
+
+enum opcode_t : uint8_t {
+  op_continuation = 0x0,
+  op_text = 0x1,
+  op_binary = 0x2,
+  op_close = 0x8,
+  op_ping = 0x9,
+  op_pong = 0xa
+};
+
+// XOR len bytes at data with the four byte masking_key, starting at position offset of the key.
+void apply_mask(char* data, size_t len, char const masking_key[4], size_t offset);
+
+// A received message (or control frame).
+//
+// The payload is not copied: it consists of the segments of the input buffer
+// that it was received in (one or more per frame).
+class Message
+{
+ private:
+  opcode_t m_opcode;
+  std::vector<MsgBlock> m_segments;
+  size_t m_size;
+
+ public:
+  Message() : m_opcode(op_continuation), m_size(0) { }
+
+  opcode_t opcode() const { return m_opcode; }
+  std::vector<MsgBlock> const& segments() const { return m_segments; }
+  size_t size() const { return m_size; }
+
+  // Copy the payload into a contiguous string.
+  std::string to_string() const;
+
+ private:
+  friend class FrameDecoder;
+  void start(opcode_t opcode) { m_opcode = opcode; }
+  void append(MsgBlock&& segment) { m_size += segment.get_size(); m_segments.push_back(std::move(segment)); }
+  void clear() { m_segments.clear(); m_size = 0; }
+};
+
+// Decoder for WebSocket frames.
+//
+// Frame headers are found and parsed in the input buffer. The payload is
+// passed on in the pieces that it was received in; masked payload is unmasked
+// in place. Fragmented messages are collected until the final fragment was received.
+//
+// Derive from this class and override message_received (and optionally control_frame_received).
+//
+class FrameDecoder : public Decoder
+{
+ public:
+  static constexpr size_t s_default_max_message_size = 16 * 1024 * 1024;
+
+  // The states that we can be in.
+  enum state_st {
+    frame_header,
+    payload_data
+  };
+
+ private:
+  bool const m_server_side;                     // Frames from a client must be masked, frames from a server must not.
+  size_t const m_max_message_size;
+  state_st m_state;
+  int m_header_seen;                            // The number of bytes of the current frame header seen by end_of_msg_finder.
+  int m_header_length;                          // The length of the current frame header (only valid once m_header_seen > 1).
+  uint64_t m_payload_remaining;                 // The number of bytes of the payload of the current frame still to be received.
+  bool m_fin;                                   // The FIN bit of the current frame.
+  bool m_masked;                                // The MASK bit of the current frame.
+  char m_masking_key[4];
+  size_t m_mask_offset;                         // The number of payload bytes of the current frame unmasked so far.
+  Message* m_current;                           // Either &m_message or &m_control_frame.
+  bool m_message_in_progress;                   // Set when a non-final data frame was received.
+  Message m_message;                            // The data message that is being received.
+  Message m_control_frame;                      // The control frame that is being received.
+
+ public:
+  FrameDecoder(bool server_side, size_t max_message_size = s_default_max_message_size) :
+    m_server_side(server_side), m_max_message_size(max_message_size), m_state(frame_header),
+    m_header_seen(0), m_header_length(2), m_payload_remaining(0), m_fin(false), m_masked(false), m_masking_key{},
+    m_mask_offset(0), m_current(&m_message), m_message_in_progress(false) { }
+
+ protected:
+  size_t end_of_msg_finder(char const* new_data, size_t rlen, EndOfMsgFinderResult& result) override;
+  bool has_stateless_end_of_msg_finder() const override { return false; }
+  void decode(int& allow_deletion_count, MsgBlock&& msg) override;
+
+  // Called when a complete text or binary message was received.
+  virtual void message_received(int& allow_deletion_count, Message&& message) = 0;
+
+  // Called when a ping, pong or close frame was received. A ping should be
+  // answered with a pong (FrameEncoder::write_frame). The default closes
+  // the input device when a close frame is received and ignores the rest.
+  virtual void control_frame_received(int& allow_deletion_count, Message&& control_frame);
+
+ private:
+  void decode_frame_header(MsgBlock const& msg);
+  void end_of_frame(int& allow_deletion_count);
+};
+
+// Writes WebSocket frames to an ostream (normally an OutputStream).
+class FrameEncoder
+{
+ private:
+  std::ostream& m_output;
+  bool const m_mask;                            // Clients must mask their frames.
+  std::random_device m_masking_key_generator;   // Masking keys must not be predictable (RFC 6455, section 5.3).
+
+ public:
+  FrameEncoder(std::ostream& output, bool client_side) : m_output(output), m_mask(client_side) { }
+
+  void write_frame(opcode_t opcode, std::string_view payload, bool fin = true);
+  void write_message(opcode_t opcode, std::string_view payload) { write_frame(opcode, payload); }
+  void write_close(uint16_t status_code, std::string_view reason = {});
+};
+
+// The value of Sec-WebSocket-Accept for a given Sec-WebSocket-Key.
+std::string accept_key(std::string_view sec_websocket_key);
+
+// The client side of the opening handshake.
+class ClientHandshake
+{
+ private:
+  std::string m_key;                            // Sec-WebSocket-Key.
+
+ public:
+  ClientHandshake();
+
+  // Write the GET request that asks to upgrade the connection.
+  void write_request(std::ostream& output, std::string_view host, std::string_view request_target, std::string_view protocols = {}) const;
+
+  // Returns true if response accepts the upgrade.
+  bool verify(http::ResponseHeadersDecoder const& response) const;
+};
+
+} // namespace websocket
+} // namespace protocol
+} // namespace evio
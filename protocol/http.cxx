@@ -1,7 +1,11 @@
 #include "sys.h"
-#include "evio/protocol/EOFDecoder.h"
 #include "http.h"
 #include <charconv>
+#include <cstring>
+#include <strings.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #ifdef CWDEBUG
 #include "utils/debug_ostream_operators.h"
 #endif
@@ -10,19 +14,170 @@ namespace evio {
 namespace protocol {
 namespace http {
 
+namespace {
+
+// Remove leading and trailing OWS.
+std::string_view trim_ows(std::string_view sv)
+{
+  while (!sv.empty() && (sv.front() == ' ' || sv.front() == '\t'))
+    sv.remove_prefix(1);
+  while (!sv.empty() && (sv.back() == ' ' || sv.back() == '\t'))
+    sv.remove_suffix(1);
+  return sv;
+}
+
+// Case-insensitive comparison of a token with a lower case string literal.
+template<size_t N>
+bool token_equals(std::string_view token, char const (&lower_case_literal)[N])
+{
+  return token.size() == N - 1 && strncasecmp(token.data(), lower_case_literal, N - 1) == 0;
+}
+
+} // namespace
+
+ContentTypeMap::ContentTypeMap(std::vector<std::pair<std::string, evio::Sink&>> const& content_type_to_decoder_map)
+{
+  for (auto&& content_type_decoder_pair : content_type_to_decoder_map)
+    add(content_type_decoder_pair.first, content_type_decoder_pair.second);
+}
+
+size_t ContentTypeMap::lower_case_media_type(char* lower_case, std::string_view content_type)
+{
+  // Content-Type = media-type
+  // media-type   = type "/" subtype *( OWS ";" OWS parameter )
+  std::string_view media_type = trim_ows(content_type.substr(0, content_type.find(';')));
+  if (media_type.empty() || media_type.size() > s_max_media_type_length)
+    return 0;
+  ascii_to_lower(lower_case, media_type.data(), media_type.size());
+  return media_type.size();
+}
+
+int ContentTypeMap::slot_of(char const* lower_case, size_t len, uint32_t hash) const
+{
+  // Linear probing; there is always at least one empty slot.
+  size_t const mask = m_slots.size() - 1;
+  for (size_t slot = hash & mask;; slot = (slot + 1) & mask)
+  {
+    int index = m_slots[slot];
+    if (index == -1)
+      return slot;
+    Entry const& entry = m_entries[index];
+    if (entry.m_hash == hash && entry.m_media_type.size() == len && std::memcmp(entry.m_media_type.data(), lower_case, len) == 0)
+      return slot;
+  }
+}
+
+void ContentTypeMap::add(std::string_view content_type, evio::Sink& decoder)
+{
+  char lower_case[s_max_media_type_length];
+  size_t len = lower_case_media_type(lower_case, content_type);
+  if (len == 0)
+    THROW_ALERT("Invalid media type [[CONTENT_TYPE]]", AIArgs("[CONTENT_TYPE]", content_type));
+  uint32_t hash = lower_case_hash(lower_case, len);
+  if (!m_slots.empty() && m_slots[slot_of(lower_case, len, hash)] != -1)
+    return;                                     // Already added.
+  m_entries.push_back({std::string(lower_case, len), hash, &decoder});
+  // Keep the load factor at or below 0.5.
+  if (2 * m_entries.size() > m_slots.size())
+  {
+    m_slots.assign(std::max(size_t{8}, 2 * m_slots.size()), -1);
+    for (int index = 0; index < static_cast<int>(m_entries.size()); ++index)
+    {
+      Entry const& entry = m_entries[index];
+      m_slots[slot_of(entry.m_media_type.data(), entry.m_media_type.size(), entry.m_hash)] = index;
+    }
+  }
+  else
+    m_slots[slot_of(lower_case, len, hash)] = m_entries.size() - 1;
+}
+
+evio::Sink* ContentTypeMap::find(std::string_view content_type) const
+{
+  if (m_slots.empty())
+    return nullptr;
+  char lower_case[s_max_media_type_length];
+  size_t len = lower_case_media_type(lower_case, content_type);
+  if (len == 0)
+    return nullptr;
+  int index = m_slots[slot_of(lower_case, len, lower_case_hash(lower_case, len))];
+  return index == -1 ? nullptr : m_entries[index].m_decoder;
+}
+
+EndOfMessageSink::EndOfMessageSink(MessageDecoder& message_decoder) : m_message_decoder(message_decoder)
+{
+  // Set content length to zero, which will cause end_of_content to be called as soon as we are switched to.
+  set_next_decoder(m_message_decoder, [](){ return 0; });
+}
+
+void EndOfMessageSink::end_of_content(int& allow_deletion_count)
+{
+  DoutEntering(dc::decoder, "http::EndOfMessageSink::end_of_content({" << allow_deletion_count << "})");
+  if (!m_message_decoder.end_of_message())
+  {
+    close_input_device(allow_deletion_count);
+    m_message_decoder.connection_closed();
+  }
+  // Switch back to the MessageDecoder for the next message.
+  set_next_decoder(m_message_decoder, [](){ return 0; });
+}
+
+size_t MessageDecoder::find_end_of_header_block(char const* new_data, size_t rlen)
+{
+  // Advance the number of matched characters of "\r\n\r\n" with one character.
+  auto advance = [](int matched, char c) -> int {
+    if (c == "\r\n\r\n"[matched])
+      return matched + 1;
+    return c == '\r' ? 1 : 0;
+  };
+
+  size_t i = 0;
+  // Finish a match that was started at the end of the previous data.
+  while (m_crlfcrlf_matched > 0 && i < rlen)
+    if ((m_crlfcrlf_matched = advance(m_crlfcrlf_matched, new_data[i++])) == 4)
+    {
+      m_crlfcrlf_matched = 0;
+      return i;
+    }
+
+#ifdef __SSE2__
+  // Test 16 starting positions at once; this needs three more bytes beyond those.
+  __m128i const cr = _mm_set1_epi8('\r');
+  __m128i const lf = _mm_set1_epi8('\n');
+  for (; i + 19 <= rlen; i += 16)
+  {
+    char const* p = new_data + i;
+    __m128i m = _mm_and_si128(
+        _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const*>(p)), cr),
+                      _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const*>(p + 1)), lf)),
+        _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const*>(p + 2)), cr),
+                      _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const*>(p + 3)), lf)));
+    unsigned int mask = _mm_movemask_epi8(m);
+    if (mask)
+      return i + __builtin_ctz(mask) + 4;
+  }
+#endif
+
+  // The last few bytes (this might be the start of a match that ends in the next data).
+  for (; i < rlen; ++i)
+    if ((m_crlfcrlf_matched = advance(m_crlfcrlf_matched, new_data[i])) == 4)
+    {
+      m_crlfcrlf_matched = 0;
+      return i + 1;
+    }
+  return 0;
+}
+
 size_t MessageDecoder::end_of_msg_finder(char const* new_data, size_t rlen, EndOfMsgFinderResult& UNUSED_ARG(result))
 {
   DoutEntering(dc::endofmsg, "http::MessageDecoder::end_of_msg_finder(..., " << rlen << ")");
+  if (m_header_block_mode && m_state == start_line)
+    return find_end_of_header_block(new_data, rlen);
   // Even when m_state == message_header_field_name we still have to detect empty lines.
   if (m_state == message_header_field_name && rlen > 0 && AI_UNLIKELY(*new_data == '\r'))
   {
     m_state = empty_line;
     return (rlen > 1 && new_data[1] == '\n') ? 2 : 0;
   }
-  else if (m_state == body)
-  {
-    return m_content_length == -1 ? rlen : 0;
-  }
   char eom_char = m_state == message_header_field_name ? ':' : '\n';
   char const* eom = static_cast<char const*>(std::memchr(new_data, eom_char, rlen));
   return eom ? eom - new_data + 1 : 0;
@@ -36,6 +191,12 @@ void MessageDecoder::decode(int& allow_deletion_count, evio::MsgBlock&& msg)
     switch (m_state)
     {
       case start_line:
+        if (m_header_block_mode)
+        {
+          decode_header_block(std::move(msg));
+          headers_received(allow_deletion_count);
+          break;
+        }
         decode_start_line(msg);
         m_state = message_header_field_name;
         break;
@@ -75,41 +236,151 @@ void MessageDecoder::decode(int& allow_deletion_count, evio::MsgBlock&& msg)
         if (msg.get_size() != 2)
         {
           Dout(dc::warning, "Received an invalid header line.");  // Heh - something like "\r...\n" where ... is non-empty.
-          close_input_device(allow_deletion_count);
+          close_connection(allow_deletion_count);
           return;
         }
-        Dout(dc::decoder, "Received empty line. Content-Length is " << m_content_length);
-        // Switch decoder.
-        if (m_content_type_to_decoder_index == -1)
-        {
-          if (m_content_length != 0)
-            THROW_ALERT("No matching Content-Type found. Can not decode body of length [LENGTH]", AIArgs("[LENGTH]", m_content_length));
-          close_input_device(allow_deletion_count);
-        }
-        else
-        {
-          m_state = body;
-          Sink& new_decoder{m_content_type_to_decoder_map[m_content_type_to_decoder_index].second};
-          switch_protocol_decoder(new_decoder);
-          if (m_content_length != -1)
-            new_decoder.set_next_decoder(evio::protocol::EOFDecoder::instance(), [content_length = m_content_length](){ return content_length; });
-        }
+        headers_received(allow_deletion_count);
         break;
       case body:
-        for (auto&& p : m_headers)
-          Dout(dc::decoder, p.first << " : " << p.second);
-        m_headers.clear();
-        close_input_device(allow_deletion_count);
+        // Not reached: the body is passed to the body decoder, after which m_end_of_message resets m_state.
+        ASSERT(false);
         break;
     }
   }
   catch (AIAlert::Error const& error)
   {
     Dout(dc::warning, error << " caught in http.cxx");
-    close_input_device(allow_deletion_count);
+    decode_failed(allow_deletion_count);
+    connection_closed();
   }
 }
 
+void MessageDecoder::close_connection(int& allow_deletion_count)
+{
+  close_input_device(allow_deletion_count);
+  connection_closed();
+}
+
+void MessageDecoder::end_of_input(int& UNUSED_ARG(allow_deletion_count))
+{
+  DoutEntering(dc::decoder, "http::MessageDecoder::end_of_input() [" << this << ']');
+  // The connection was closed by the peer between two messages (or in the middle of the headers of one).
+  connection_closed();
+}
+
+void MessageDecoder::decode_header_block(evio::MsgBlock&& msg)
+{
+  DoutEntering(dc::decoder, "http::MessageDecoder::decode_header_block(" << msg << ")");
+  char const* ptr = msg.get_start();
+  // msg ends on "\r\n\r\n", so every memchr below will find a new-line.
+  char const* const end = msg.get_end();
+  char const* eol = static_cast<char const*>(std::memchr(ptr, '\n', end - ptr));
+  decode_start_line(evio::MsgBlock(ptr, eol + 1 - ptr));
+  for (;;)
+  {
+    ptr = eol + 1;
+    eol = static_cast<char const*>(std::memchr(ptr, '\n', end - ptr));
+    if (AI_UNLIKELY(eol == ptr || eol[-1] != '\r'))
+      THROW_ALERT("Ill-formed EOL in header.");
+    if (eol - ptr == 1)
+      break;                                    // The empty line.
+    char const* colon = static_cast<char const*>(std::memchr(ptr, ':', eol - ptr));
+    // Obsolete line folding (a line starting with whitespace) is not supported.
+    if (AI_UNLIKELY(!colon || colon == ptr || *ptr == ' ' || *ptr == '\t'))
+      THROW_ALERT("Ill-formed header line [[LINE]]", AIArgs("[LINE]", std::string_view(ptr, eol - 1 - ptr)));
+    process_header({ptr, static_cast<size_t>(colon - ptr)}, trim_ows({colon + 1, static_cast<size_t>(eol - 1 - (colon + 1))}));
+  }
+  // Keep the string_views in m_headers valid.
+  m_header_block = std::move(msg);
+}
+
+void MessageDecoder::headers_received(int& allow_deletion_count)
+{
+  // A Transfer-Encoding overrides any Content-Length.
+  if (m_chunked)
+    m_content_length = -1;
+  Dout(dc::decoder, "Received empty line. Content-Length is " << m_content_length << (m_chunked ? " (chunked)." : "."));
+  check_headers();
+  if (!may_have_body() || (!m_chunked && m_content_length == 0))
+  {
+    // The message is already complete.
+    bool close_connection = !end_of_message();
+    Sink* upgrade_decoder = take_upgrade_decoder(close_connection);
+    if (upgrade_decoder)
+      switch_protocol_decoder(*upgrade_decoder);
+    else if (close_connection)
+      this->close_connection(allow_deletion_count);
+    return;
+  }
+  // Switch decoder.
+  if (!m_body_decoder)
+    m_body_decoder = m_default_body_decoder;
+  if (!m_body_decoder)
+  {
+    if (m_chunked)
+      THROW_ALERT("No matching Content-Type found. Can not decode chunked body.");
+    THROW_ALERT("No matching Content-Type found. Can not decode body of length [LENGTH]", AIArgs("[LENGTH]", m_content_length));
+  }
+  m_state = body;
+  Sink* new_decoder = m_body_decoder;
+  if (m_content_coding != identity)
+  {
+    // The decompressed data can only be passed to a decoder that is passed messages.
+    Decoder* body_decoder = dynamic_cast<Decoder*>(new_decoder);
+    if (!body_decoder)
+      THROW_ALERT("Can not decompress a body for a decoder that is not derived from evio::protocol::Decoder.");
+    initialize_inner_sink(*body_decoder);
+    m_inflate_decoder.start(*body_decoder, m_content_coding == deflate);
+    new_decoder = &m_inflate_decoder;
+  }
+  if (m_chunked)
+  {
+    // The chunk framing can only be stripped when the body decoder is passed messages.
+    Decoder* body_decoder = dynamic_cast<Decoder*>(new_decoder);
+    if (!body_decoder)
+      THROW_ALERT("Can not decode a chunked body with a decoder that is not derived from evio::protocol::Decoder.");
+    initialize_inner_sink(*body_decoder);
+    m_chunked_decoder.start(*body_decoder, m_end_of_message);
+    switch_protocol_decoder(m_chunked_decoder);
+  }
+  else
+  {
+    switch_protocol_decoder(*new_decoder);
+    // If there is no Content-Length then the body is delimited by the closing of the connection;
+    // the response is then completed at EOF. Always set both, so nothing is left from a previous message.
+    if (m_content_length != -1)
+      new_decoder->set_next_decoder(m_end_of_message, [content_length = m_content_length](){ return content_length; });
+    else
+      new_decoder->set_next_decoder(m_end_of_message);
+  }
+}
+
+bool MessageDecoder::end_of_message()
+{
+  DoutEntering(dc::decoder, "http::MessageDecoder::end_of_message() [" << this << ']');
+#ifdef CWDEBUG
+  for (auto&& header_field : m_headers)
+    Dout(dc::decoder, header_field.m_name << " : " << header_field.m_value);
+#endif
+  bool persistent = is_persistent();
+  Dout(dc::decoder(!persistent), "Not a persistent connection.");
+  message_received();
+  // Prepare for the next message.
+  m_state = start_line;
+  m_headers.clear();                            // This keeps the capacity.
+  m_known_header_index.fill(-1);
+  m_header_lines.clear();
+  m_header_block = evio::MsgBlock(nullptr, 0);
+  m_chunked_decoder.clear_trailers();
+  m_content_length = -1;
+  m_body_decoder = nullptr;
+  m_chunked = false;
+  m_connection_close = false;
+  m_connection_keep_alive = false;
+  m_content_coding = identity;
+  return persistent;
+}
+
 void MessageDecoder::process_header_field_name(evio::MsgBlock&& msg)
 {
   DoutEntering(dc::decoder, "http::MessageDecoder::process_header_field_name(" << msg << ")");
@@ -119,26 +390,88 @@ void MessageDecoder::process_header_field_name(evio::MsgBlock&& msg)
 void MessageDecoder::process_header_value_name(evio::MsgBlock&& msg)
 {
   DoutEntering(dc::decoder, "http::MessageDecoder::process_header_value_name(" << msg << ")");
-  if (m_current_header_field.view() == "Content-Length")
+  process_header(m_current_header_field.view(), msg.view());
+  // Keep the string_views in m_headers valid.
+  m_header_lines.push_back(std::move(m_current_header_field));
+  m_header_lines.push_back(std::move(msg));
+}
+
+void MessageDecoder::process_header(std::string_view name, std::string_view value)
+{
+  known_header_field id = lookup_known_header_field(name);
+  switch (id)
   {
-    auto result = std::from_chars(msg.get_start(), msg.get_end(), m_content_length);
-    if (result.ec == std::errc::invalid_argument || result.ptr != msg.get_end() || m_content_length < 0)
+    case hf_content_length:
+    {
+      auto result = std::from_chars(value.data(), value.data() + value.size(), m_content_length);
+      if (result.ec == std::errc::invalid_argument || result.ptr != value.data() + value.size() || m_content_length < 0)
+      {
+        m_content_length = -1;
+        THROW_ALERTC(result.ec, "Content-Length header with invalid value [[VIEW]]", AIArgs("[VIEW]", value));
+      }
+      break;
+    }
+    case hf_transfer_encoding:
     {
-      m_content_length = -1;
-      THROW_ALERTC(result.ec, "Content-Length header with invalid value [[VIEW]]", AIArgs("[VIEW]", m_current_header_field.view()));
+      // Transfer-Encoding  = 1#transfer-coding
+      // The body is chunked if the last transfer-coding is "chunked" (case-insensitive).
+      std::string_view last_coding = value;
+      auto comma = last_coding.rfind(',');
+      if (comma != std::string_view::npos)
+        last_coding.remove_prefix(comma + 1);
+      m_chunked = token_equals(trim_ows(last_coding), "chunked");
+      break;
     }
-  }
-  else if (m_current_header_field.view() == "Content-Type")
-  {
-    for (int i = 0; i < m_content_type_to_decoder_map.size(); ++i)
-      if (m_content_type_to_decoder_map[i].first == msg.view())
+    case hf_connection:
+    {
+      // Connection = 1#connection-option
+      std::string_view options = value;
+      while (!options.empty())
       {
-        Dout(dc::decoder, "Found match.");
-        m_content_type_to_decoder_index = i;
-        break;
+        auto comma = options.find(',');
+        std::string_view option = trim_ows(options.substr(0, comma));
+        options.remove_prefix(comma == std::string_view::npos ? options.size() : comma + 1);
+        if (token_equals(option, "close"))
+          m_connection_close = true;
+        else if (token_equals(option, "keep-alive"))
+          m_connection_keep_alive = true;
       }
+      break;
+    }
+    case hf_content_encoding:
+    {
+      // Content-Encoding = 1#content-coding
+      // Only a single coding (besides identity) is supported.
+      std::string_view coding = trim_ows(value);
+      if (token_equals(coding, "gzip") || token_equals(coding, "x-gzip"))
+        m_content_coding = gzip;
+      else if (token_equals(coding, "deflate"))
+        m_content_coding = deflate;
+      else if (!coding.empty() && !token_equals(coding, "identity"))
+        THROW_ALERT("Unsupported Content-Encoding [[VALUE]]", AIArgs("[VALUE]", value));
+      break;
+    }
+    case hf_content_type:
+      m_body_decoder = m_content_type_to_decoder_map.find(value);
+      Dout(dc::decoder(m_body_decoder), "Found match.");
+      break;
+    default:
+      break;
   }
-  m_headers.emplace_back(std::move(m_current_header_field), std::move(msg));
+  if (id != hf_unknown && m_known_header_index[id] == -1)
+    m_known_header_index[id] = m_headers.size();
+  m_headers.push_back({name, value, id});
+}
+
+HeaderField const* MessageDecoder::find_header(std::string_view name) const
+{
+  known_header_field id = lookup_known_header_field(name);
+  if (id != hf_unknown)
+    return find_header(id);
+  for (auto&& header_field : m_headers)
+    if (header_field.m_name.size() == name.size() && strncasecmp(header_field.m_name.data(), name.data(), name.size()) == 0)
+      return &header_field;
+  return nullptr;
 }
 
 void ResponseHeadersDecoder::decode_start_line(evio::MsgBlock const& msg)
@@ -146,6 +479,13 @@ void ResponseHeadersDecoder::decode_start_line(evio::MsgBlock const& msg)
   // Just print what was received.
   DoutEntering(dc::decoder, "http::ResponseHeadersDecoder::decode_start_line(" << msg << ") [" << this << ']');
 
+  // Reset what is left from a previous response on this connection.
+  m_protocol_error = false;
+  m_status_code = 0;
+#ifdef CWDEBUG
+  m_reason_phrase.clear();
+#endif
+
   // This is the first line of a Response Message.
   //
   // If the start line doesn't match the required response then that is an error,
@@ -223,13 +563,96 @@ void ResponseHeadersDecoder::decode_start_line(evio::MsgBlock const& msg)
     }
   }
 
-  if (m_protocol_error || m_status_code != 200)
-  {
-    if (m_protocol_error)
-      THROW_ALERT("Invalid HTTP status-line");
+  // Any valid status code is passed on to the callback of the request; the body is read as usual.
+  if (m_protocol_error)
+    THROW_ALERT("Invalid HTTP status-line");
+  if (m_status_code < 100 || m_status_code > 599)
     THROW_ALERT("Received status code [STATUS_CODE]" CWDEBUG_ONLY("[REASON_PHRASE]"),
         AIArgs("[STATUS_CODE]", m_status_code)CWDEBUG_ONLY(("[REASON_PHRASE]", m_reason_phrase)));
+  Dout(dc::decoder(m_status_code >= 300), "Received status code " << m_status_code);
+}
+
+bool ResponseHeadersDecoder::may_have_body() const
+{
+  // RFC7230, section 3.3.3: responses to a HEAD request and all 1xx (Informational),
+  // 204 (No Content) and 304 (Not Modified) responses are terminated by the empty line.
+  if (m_status_code < 200 || m_status_code == 204 || m_status_code == 304)
+    return false;
+  pending_requests_t::crat pending_requests_r(m_pending_requests);
+  return pending_requests_r->empty() || !pending_requests_r->front().m_head_request;
+}
+
+void ResponseHeadersDecoder::expect_response(response_callback_type response_callback, bool head_request)
+{
+  DoutEntering(dc::decoder, "http::ResponseHeadersDecoder::expect_response(..., " << head_request << ") [" << this << ']');
+  pending_requests_t::wat(m_pending_requests)->push_back({std::move(response_callback), head_request, {}, nullptr});
+}
+
+void ResponseHeadersDecoder::expect_upgrade(upgrade_callback_type upgrade_callback, evio::Sink& upgrade_decoder)
+{
+  DoutEntering(dc::decoder, "http::ResponseHeadersDecoder::expect_upgrade(..., " << &upgrade_decoder << ") [" << this << ']');
+  pending_requests_t::wat(m_pending_requests)->push_back({{}, false, std::move(upgrade_callback), &upgrade_decoder});
+}
+
+void ResponseHeadersDecoder::message_received()
+{
+  DoutEntering(dc::decoder, "http::ResponseHeadersDecoder::message_received() [" << this << ']');
+  // An interim response is followed by the final response to the same request (101 Switching Protocols is final).
+  if (m_status_code < 200 && m_status_code != 101)
+    return;
+  PendingRequest pending_request;
+  {
+    pending_requests_t::wat pending_requests_w(m_pending_requests);
+    if (pending_requests_w->empty())
+    {
+      Dout(dc::decoder, "No expect_response for this response.");
+      return;
+    }
+    pending_request = std::move(pending_requests_w->front());
+    pending_requests_w->pop_front();
   }
+  // Call the callback without holding the lock, it might call expect_response.
+  if (pending_request.m_upgrade_decoder)
+  {
+    bool accepted = !pending_request.m_upgrade_callback || pending_request.m_upgrade_callback(*this);
+    if (accepted && m_status_code == 101)
+      m_upgrade_decoder = pending_request.m_upgrade_decoder;
+  }
+  else if (pending_request.m_response_callback)
+    pending_request.m_response_callback(*this);
+}
+
+void ResponseHeadersDecoder::fail_pending_requests()
+{
+  std::deque<PendingRequest> pending_requests;
+  pending_requests_t::wat(m_pending_requests)->swap(pending_requests);
+  if (pending_requests.empty())
+    return;
+  DoutEntering(dc::decoder, "http::ResponseHeadersDecoder::fail_pending_requests() [" << this << "]: " << pending_requests.size() << " requests.");
+  m_status_code = 0;
+  // Call the callbacks without holding the lock.
+  for (PendingRequest& pending_request : pending_requests)
+  {
+    if (pending_request.m_upgrade_decoder)
+    {
+      if (pending_request.m_upgrade_callback)
+        pending_request.m_upgrade_callback(*this);
+    }
+    else if (pending_request.m_response_callback)
+      pending_request.m_response_callback(*this);
+  }
+}
+
+evio::Sink* ResponseHeadersDecoder::take_upgrade_decoder(bool& close_connection)
+{
+  if (m_status_code != 101)
+    return nullptr;
+  evio::Sink* upgrade_decoder = m_upgrade_decoder;
+  m_upgrade_decoder = nullptr;
+  // After a 101 response the connection no longer speaks HTTP.
+  if (!upgrade_decoder)
+    close_connection = true;
+  return upgrade_decoder;
 }
 
 } // namespace http
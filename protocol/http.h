@@ -1,8 +1,18 @@
 #pragma once
 
 #include "Decoder.h"
+#include "ChunkedDecoder.h"
+#include "HeaderFieldName.h"
+#include "InflateDecoder.h"
 #include "evio/StreamBuf.h"
+#include "threadsafe/aithreadsafe.h"
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -10,8 +20,92 @@ namespace evio {
 namespace protocol {
 namespace http {
 
+class MessageDecoder;
+
+// A header field of the current message.
+// Both string_views point into the input buffer, which is kept alive by the MessageDecoder.
+struct HeaderField
+{
+  std::string_view m_name;
+  std::string_view m_value;             // Without leading and trailing OWS.
+  known_header_field m_id;              // hf_unknown if m_name isn't a well-known header field name.
+};
+
+// Maps media types (as found in a Content-Type header) to the decoder of the body.
+//
+// The lookup ignores case and any parameters (";charset=utf-8" etc). The lower
+// case media type is hashed with the same hash function that is used for the
+// well-known header field names and looked up in an open addressing table.
+class ContentTypeMap
+{
+ private:
+  struct Entry
+  {
+    std::string m_media_type;           // Lower case, without parameters.
+    uint32_t m_hash;
+    evio::Sink* m_decoder;
+  };
+
+  static constexpr size_t s_max_media_type_length = 128;        // Longer media types are never found.
+
+  std::vector<Entry> m_entries;
+  std::vector<int> m_slots;             // Indices into m_entries, or -1 when empty. The size is a power of two.
+
+ public:
+  ContentTypeMap(std::vector<std::pair<std::string, evio::Sink&>> const& content_type_to_decoder_map);
+
+  // Add a media type. The first decoder that was added for a given media type wins.
+  void add(std::string_view content_type, evio::Sink& decoder);
+
+  // Returns the decoder for content_type, or nullptr if there is none.
+  evio::Sink* find(std::string_view content_type) const;
+
+ private:
+  // Copy the media type of content_type to lower_case (which must have room for s_max_media_type_length characters).
+  // Returns the length of the media type, or 0 if there is none or it is too long.
+  static size_t lower_case_media_type(char* lower_case, std::string_view content_type);
+  int slot_of(char const* lower_case, size_t len, uint32_t hash) const;
+};
+
+// Helper sink that is switched to after the body of a message was received.
+// It notifies the MessageDecoder (possibly closing the input device) and then
+// switches back to it, much like EOFDecoder does (but without closing).
+class EndOfMessageSink : public Sink
+{
+ private:
+  MessageDecoder& m_message_decoder;
+
+ public:
+  EndOfMessageSink(MessageDecoder& message_decoder);
+
+ protected:
+  size_t end_of_msg_finder(char const* UNUSED_ARG(new_data), size_t CWDEBUG_ONLY(rlen), EndOfMsgFinderResult& UNUSED_ARG(result)) override
+  {
+    DoutEntering(dc::endofmsg, "http::EndOfMessageSink::end_of_msg_finder({" << rlen << "}) = 0");
+    return 0;
+  }
+
+  void end_of_content(int& allow_deletion_count) override;
+};
+
 // Coded while reading https://www.w3.org/Protocols/rfc2616/rfc2616-sec4.html#sec4.1
 //
+// After a complete message was received the decoder resets itself to start_line
+// and is ready for the next message on the same connection (persistent connections,
+// RFC7230 section 6.3). The input device is only closed when the message says
+// so ("Connection: close", or HTTP/1.0 without "Connection: keep-alive"), or
+// when the length of the body is only delimited by the closing of the connection.
+//
+// By default every header line is passed to decode separately. After calling
+// set_header_block_mode() the whole header block is found at once (by searching
+// for the CRLF CRLF that terminates it) and parsed in a single pass instead.
+// This requires that the header block fits in the input buffer (which is also
+// required if the lines are decoded one by one, but then only when they are
+// all received in a single read).
+//
+// A body with "Content-Encoding: gzip" or "deflate" is decompressed on the fly
+// (see InflateDecoder); the body decoder then must be derived from Decoder.
+//
 class MessageDecoder : public evio::protocol::Decoder
 {
  public:
@@ -19,6 +113,9 @@ class MessageDecoder : public evio::protocol::Decoder
   static constexpr int s_http_major = 1;
   static constexpr int s_http_minor = 1;
 
+  // Initial capacity of the header table.
+  static constexpr size_t s_reserved_headers = 32;
+
   // The states that we can be in.
   enum state_st {
     start_line,
@@ -28,35 +125,135 @@ class MessageDecoder : public evio::protocol::Decoder
     body
   };
 
+  // The supported content-codings.
+  enum content_coding_st {
+    identity,
+    gzip,
+    deflate
+  };
+
  private:
   state_st m_state;
-  std::vector<std::pair<std::string, evio::Sink&>> m_content_type_to_decoder_map;
+  ContentTypeMap m_content_type_to_decoder_map;
   evio::MsgBlock m_current_header_field;
-  std::vector<std::pair<evio::MsgBlock, evio::MsgBlock>> m_headers;   // Field, Value pairs.
+  std::vector<HeaderField> m_headers;   // The header fields of the current message.
+  std::array<int16_t, number_of_known_header_fields> m_known_header_index;      // Index into m_headers of the first header field with a given known name, or -1.
+  std::vector<evio::MsgBlock> m_header_lines;   // Keeps the memory that m_headers points to alive, when decoding line by line.
+  evio::MsgBlock m_header_block;        // Keeps the memory that m_headers points to alive, in header block mode.
+  bool m_header_block_mode;             // Set when the whole header block is decoded at once.
+  int m_crlfcrlf_matched;               // The number of characters of "\r\n\r\n" matched at the end of the previous data (header block mode).
   int m_content_length;
-  int m_content_type_to_decoder_index;
+  evio::Sink* m_body_decoder;           // The decoder that matches the Content-Type, if any.
+  evio::Sink* m_default_body_decoder;   // The decoder to use when no Content-Type matched, or nullptr.
+  bool m_chunked;                       // Set when the last transfer-coding is "chunked".
+  bool m_connection_close;              // Set when a "Connection: close" header was received.
+  bool m_connection_keep_alive;         // Set when a "Connection: keep-alive" header was received.
+  content_coding_st m_content_coding;   // The Content-Encoding of the body.
+  ChunkedDecoder m_chunked_decoder;     // Strips the chunk framing from the body when m_chunked is set.
+  InflateDecoder m_inflate_decoder;     // Decompresses the body when m_content_coding isn't identity.
+  EndOfMessageSink m_end_of_message;    // Switched to after the body was received.
+
+ protected:
+  int m_http_minor;                     // The minor version of the current message (set by decode_start_line).
 
  public:
   MessageDecoder(std::vector<std::pair<std::string, evio::Sink&>> content_type_to_decoder_map = {}) :
-    m_content_type_to_decoder_map(std::move(content_type_to_decoder_map)),
-    m_content_type_to_decoder_index(-1), m_state(start_line), m_current_header_field(nullptr, 0), m_content_length(-1) { }
+    m_state(start_line), m_content_type_to_decoder_map(content_type_to_decoder_map),
+    m_current_header_field(nullptr, 0), m_header_block(nullptr, 0), m_header_block_mode(false), m_crlfcrlf_matched(0),
+    m_content_length(-1), m_body_decoder(nullptr), m_default_body_decoder(nullptr),
+    m_chunked(false), m_connection_close(false), m_connection_keep_alive(false), m_content_coding(identity), m_end_of_message(*this), m_http_minor(0)
+  {
+    m_headers.reserve(s_reserved_headers);
+    m_known_header_index.fill(-1);
+  }
+
+  // Decode the whole header block at once, instead of line by line.
+  // Must be called before the first message is received.
+  void set_header_block_mode(bool header_block_mode = true) { m_header_block_mode = header_block_mode; }
 
   void add(std::pair<std::string, evio::protocol::Decoder&> content_type_decoder_pair)
   {
-    m_content_type_to_decoder_map.push_back(content_type_decoder_pair);
+    m_content_type_to_decoder_map.add(content_type_decoder_pair.first, content_type_decoder_pair.second);
+  }
+
+  // Pass the body of messages without a matching (or any) Content-Type to body_decoder.
+  void set_default_decoder(evio::Sink& body_decoder) { m_default_body_decoder = &body_decoder; }
+
+  // This is called by the body decoder.
+  // Returns -1 when the length is not known in advance (also when the body is chunked or compressed).
+  int content_length() const { return m_content_coding == identity ? m_content_length : -1; }
+
+  // The Content-Encoding of the body. The body decoder is passed the decompressed data.
+  content_coding_st content_coding() const { return m_content_coding; }
+
+  // True if the body is (being) received with "Transfer-Encoding: chunked".
+  bool is_chunked() const { return m_chunked; }
+
+  // Accessor for the trailer fields of a chunked body.
+  std::vector<std::pair<evio::MsgBlock, evio::MsgBlock>> const& trailers() const { return m_chunked_decoder.trailers(); }
+
+  // Accessor for the header fields of the current message.
+  // Only valid until message_received returns.
+  std::vector<HeaderField> const& headers() const { return m_headers; }
+
+  // Returns the first header field with the well-known name id, or nullptr if there is none. Also only valid until message_received returns.
+  HeaderField const* find_header(known_header_field id) const
+  {
+    int16_t index = m_known_header_index[id];
+    return index == -1 ? nullptr : &m_headers[index];
   }
 
-  // This is called by m_content_type_to_decoder_map[m_content_type_to_decoder_index].second.
-  int content_length() const { return m_content_length; }
+  // Case-insensitive lookup of any header field name. Well-known names are found in constant time.
+  HeaderField const* find_header(std::string_view name) const;
+
+  // Returns true if the connection may be used for a next message after the current one.
+  bool is_persistent() const { return !m_connection_close && (m_http_minor > 0 || m_connection_keep_alive); }
 
  protected:
   size_t end_of_msg_finder(char const* new_data, size_t rlen, EndOfMsgFinderResult& result) override;
+  bool has_stateless_end_of_msg_finder() const override { return false; }
   void decode(int& allow_deletion_count, evio::MsgBlock&& msg) override;
   void process_header_field_name(evio::MsgBlock&& msg);
   void process_header_value_name(evio::MsgBlock&& msg);
+  void process_header(std::string_view name, std::string_view value);
+  void decode_header_block(evio::MsgBlock&& msg);
+  void headers_received(int& allow_deletion_count);
+  size_t find_end_of_header_block(char const* new_data, size_t rlen);
 
   // Throws upon failure.
   virtual void decode_start_line(evio::MsgBlock const& msg) = 0;
+
+  // Return false if the current message can not have a body (regardless of the header fields).
+  virtual bool may_have_body() const { return true; }
+
+  // Called after all header fields of a message were received, before its body.
+  // Throw to reject the message. The default accepts everything.
+  virtual void check_headers() const { }
+
+  // Called when decoding failed (an AIAlert::Error was thrown). The default closes the input device.
+  virtual void decode_failed(int& allow_deletion_count) { close_input_device(allow_deletion_count); }
+
+  // Called after this decoder closed the input device, after decode_failed, and when EOF
+  // was reached between two messages. The default does nothing.
+  virtual void connection_closed() { }
+
+  // Called after a message without body was received, after message_received.
+  // Return the decoder to switch to when the connection switched to another
+  // protocol (101 Switching Protocols), or nullptr. Set close_connection when
+  // the connection can not be used anymore.
+  virtual evio::Sink* take_upgrade_decoder(bool& UNUSED_ARG(close_connection)) { return nullptr; }
+
+  // Called after the whole message (including its body) was received.
+  // The default does nothing.
+  virtual void message_received() { }
+
+  void end_of_input(int& allow_deletion_count) override;
+
+ private:
+  void close_connection(int& allow_deletion_count);
+  friend class EndOfMessageSink;
+  // Call message_received and reset for the next message. Returns true if the input device should stay open.
+  bool end_of_message();
 };
 
 // Accept HTTP Response input of the form:
@@ -74,22 +271,63 @@ class MessageDecoder : public evio::protocol::Decoder
 //
 // socket.set_protocol_decoder(http_decoder);   // Or whatever InputDevice is being used.
 //
+// When more than one request is sent over the same connection (possibly
+// pipelined: sending the next request before the previous response was
+// received), call expect_response once for every request, in the order that
+// the requests are written. The responses are matched against those calls
+// in order; the callback is called when the corresponding response was received
+// completely, whatever its status code (see get_status_code()). A 4xx or 5xx
+// response does not close the connection, unless the server asks for that.
+//
+// When the connection is closed, the callbacks of all requests that did not
+// receive a response yet are called with a status code of 0. That happens
+// automatically when this decoder closes the connection, or when the connection
+// is closed between two responses. When the connection is closed otherwise (for
+// example by a read error, or in the middle of a body) call fail_pending_requests()
+// from the disconnected callback of the socket.
+//
+// For a request with "Upgrade" header fields call expect_upgrade instead.
+// If the response is "101 Switching Protocols" and the callback returns true,
+// the connection switches to the given decoder (for example a websocket::FrameDecoder).
+// Otherwise a 101 response closes the connection.
+//
 class ResponseHeadersDecoder : public MessageDecoder
 {
+ public:
+  using response_callback_type = std::function<void(ResponseHeadersDecoder const&)>;
+  using upgrade_callback_type = std::function<bool(ResponseHeadersDecoder const&)>;
+
  private:
+  struct PendingRequest
+  {
+    response_callback_type m_response_callback;
+    bool m_head_request;                // A response to a HEAD request never has a body.
+    upgrade_callback_type m_upgrade_callback;   // Used instead of m_response_callback when m_upgrade_decoder is set.
+    evio::Sink* m_upgrade_decoder;      // The decoder to switch to after "101 Switching Protocols", or nullptr.
+  };
+  using pending_requests_t = aithreadsafe::Wrapper<std::deque<PendingRequest>, aithreadsafe::policy::Primitive<std::mutex>>;
+
   // We only understand major version 1.
-  int m_http_minor;     // 0 or 1.
   bool m_protocol_error;
   int m_status_code;
 #ifdef CWDEBUG
   std::string m_reason_phrase;
 #endif
+  pending_requests_t m_pending_requests;        // Requests that were sent, but for which no response was received yet.
+  evio::Sink* m_upgrade_decoder;                // Set by message_received when the upgrade was accepted.
 
  public:
   // Until the server tells us otherwise, we have to speak verion 1.0.
   // m_http_minor is updated at the moment that m_state != start_line.
   ResponseHeadersDecoder(std::vector<std::pair<std::string, evio::Sink&>> args) :
-    MessageDecoder(args), m_http_minor(0), m_protocol_error(false), m_status_code(0) { }
+    MessageDecoder(args), m_protocol_error(false), m_status_code(0), m_upgrade_decoder(nullptr) { }
+
+  // Call this for every request that is written to the connection (in the same order).
+  // This may be called by a different thread than the one that decodes the responses.
+  void expect_response(response_callback_type response_callback, bool head_request = false);
+
+  // Like expect_response, but for a request that asks to switch to another protocol.
+  void expect_upgrade(upgrade_callback_type upgrade_callback, evio::Sink& upgrade_decoder);
 
   // Most HTML header lines are very short (in the order of 32 bytes or less),
   // but some header lines, most notably cookies can be rather long (say, 300 bytes).
@@ -98,11 +336,18 @@ class ResponseHeadersDecoder : public MessageDecoder
   // in the allocated buffer that will be 6 times as large, or 1536 bytes.
   size_t average_message_length() const override { return 256; }
 
-  // Accessor for m_status_code. Should be 200 when successful.
+  // Accessor for m_status_code. Should be 2xx when successful, and is 0 when the connection was closed before the response was received.
   int get_status_code() const { return m_status_code; }
 
+  // Call the callbacks of all requests that did not receive a response, with a status code of 0.
+  void fail_pending_requests();
+
  protected:
   void decode_start_line(evio::MsgBlock const& msg) override;
+  bool may_have_body() const override;
+  void message_received() override;
+  evio::Sink* take_upgrade_decoder(bool& close_connection) override;
+  void connection_closed() override { fail_pending_requests(); }
 };
 
 } // namespace http
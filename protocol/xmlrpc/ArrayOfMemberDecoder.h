@@ -1,6 +1,7 @@
 #pragma once
 
 #include "DecoderBase.h"
+#include "initialize.h"
 #include "utils/AIAlert.h"
 #include <vector>
 #include "debug.h"
@@ -29,9 +30,9 @@ class ArrayOfMemberDecoder : public DecoderBase<std::vector<T>>
     m_array_element = &this->m_member.back();
   }
 
-  void got_characters(std::string_view const& data) override
+  void got_characters(std::string_view const& data, UTF8_SAX_Decoder const& source) override
   {
-    initialize(*m_array_element, data);
+    initialize(*m_array_element, data, source);
     Dout(dc::notice, "Initialized new array element with '" << data << "'.");
   }
 
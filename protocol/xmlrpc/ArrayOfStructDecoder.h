@@ -17,14 +17,10 @@ class ArrayOfStructDecoder : public StructDictionary<T>, public DecoderBase<std:
  protected:
   ElementDecoder* create_member_decoder(std::string_view const& name) override
   {
-    try
-    {
-      return m_array_element->create_member_decoder(this->get_member(name));
-    }
-    catch (typename StructDictionary<T>::UnknownMember const&)
-    {
+    auto member = this->get_member(name);
+    if (!member)
       return &IgnoreElement::s_ignore_element;
-    }
+    return m_array_element->create_member_decoder(*member);
   }
 
  private:
@@ -0,0 +1,13 @@
+#include "sys.h"
+#include "BinaryDecoder.h"
+#include "debug.h"
+
+namespace evio::protocol::xmlrpc {
+
+void BinaryDecoder::frame_received(int& allow_deletion_count, std::string_view UNUSED_ARG(header), MsgBlock&& payload)
+{
+  MsgPackReader reader({payload.get_start(), payload.get_size()});
+  decode_message(allow_deletion_count, reader);
+}
+
+} // namespace evio::protocol::xmlrpc
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "evio/protocol/LengthPrefixDecoder.h"
+#include "BinaryEncoder.h"
+#include "MsgPackReader.h"
+#include "read_msgpack.h"
+
+namespace evio::protocol::xmlrpc {
+
+// Splits the input into the length prefixed messages written by BinaryEncoder
+// and passes the MessagePack of each message to decode_message.
+class BinaryDecoder : public protocol::LengthPrefixDecoder
+{
+ public:
+  BinaryDecoder(size_t max_message_size = s_default_max_payload_size) :
+    LengthPrefixDecoder({LengthPrefixFormat::big_endian, BinaryEncoder::s_length_prefix_size}, max_message_size) { }
+
+ protected:
+  void frame_received(int& allow_deletion_count, std::string_view header, MsgBlock&& payload) final;
+
+  // Called for every message.
+  virtual void decode_message(int& allow_deletion_count, MsgPackReader& reader) = 0;
+};
+
+// Decodes every message into response and then calls response_received.
+template<typename T>
+class BinaryResponseDecoder : public BinaryDecoder
+{
+ private:
+  T& m_response;
+
+ protected:
+  void decode_message(int& allow_deletion_count, MsgPackReader& reader) final
+  {
+    read_msgpack(reader, m_response);
+    response_received(allow_deletion_count);
+  }
+
+  virtual void response_received(int& allow_deletion_count) = 0;
+
+ public:
+  BinaryResponseDecoder(T& response) : m_response(response) { }
+};
+
+} // namespace evio::protocol::xmlrpc
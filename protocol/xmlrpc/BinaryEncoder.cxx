@@ -0,0 +1,43 @@
+#include "sys.h"
+#include "BinaryEncoder.h"
+#include "Request.h"
+#include "utils/AIAlert.h"
+#include "debug.h"
+
+namespace evio::protocol::xmlrpc {
+
+//static
+void BinaryEncoder::write_length_prefix(Writer& writer, size_t length)
+{
+  if (length > 0xffffffff)
+    THROW_ALERT("Binary XML RPC message of [LENGTH] bytes is too large", AIArgs("[LENGTH]", length));
+  char prefix[s_length_prefix_size] = { static_cast<char>(length >> 24), static_cast<char>(length >> 16), static_cast<char>(length >> 8), static_cast<char>(length) };
+  writer.write({prefix, s_length_prefix_size});
+}
+
+BinaryEncoder& operator<<(BinaryEncoder& encoder, Request const& request)
+{
+  // [methodName, [param...]]
+  MsgPackSize size;
+  msgpack::write_array_header(size, 2);
+  msgpack::write_str(size, request.method_name());
+  size_t number_of_params = 0;
+  for (RequestParam const* param : request)
+  {
+    size.m_size += param->msgpack_size();
+    ++number_of_params;
+  }
+  msgpack::write_array_header(size, number_of_params);
+
+  Writer writer(encoder.m_output);
+  BinaryEncoder::write_length_prefix(writer, size.m_size);
+  msgpack::write_array_header(writer, 2);
+  msgpack::write_str(writer, request.method_name());
+  msgpack::write_array_header(writer, number_of_params);
+  for (RequestParam const* param : request)
+    param->write_msgpack(writer);
+
+  return encoder;
+}
+
+} // namespace evio::protocol::xmlrpc
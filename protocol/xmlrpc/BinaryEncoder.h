@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Writer.h"
+#include "write_msgpack.h"
+#include <cstdint>
+#include <iosfwd>
+
+namespace evio::protocol::xmlrpc {
+
+class Request;
+
+// Encodes requests in the compact binary alternative of XML RPC, for peers that both support it.
+//
+// Every message is a four byte big endian length followed by that many bytes of MessagePack.
+// A request is the array [methodName, [param...]], where each param is encoded with write_msgpack;
+// a response is the result value itself. Structs are maps with the same member names as in XML RPC.
+// See BinaryDecoder for the receiving side.
+//
+class BinaryEncoder
+{
+ private:
+  std::ostream& m_output;
+
+ public:
+  static constexpr size_t s_length_prefix_size = 4;
+
+  BinaryEncoder(std::ostream& output) : m_output(output) { }
+
+  // Write val as a single message.
+  template<typename T>
+  void write_message(T const& val)
+  {
+    MsgPackSize size;
+    write_msgpack(size, val);
+    Writer writer(m_output);
+    write_length_prefix(writer, size.m_size);
+    write_msgpack(writer, val);
+  }
+
+  friend BinaryEncoder& operator<<(BinaryEncoder& encoder, Request const& request);
+
+ private:
+  static void write_length_prefix(Writer& writer, size_t length);
+};
+
+} // namespace evio::protocol::xmlrpc
@@ -2,7 +2,7 @@
 #include "Decoder.h"
 #include "utils/print_using.h"
 #include "utils/c_escape.h"
-#include <charconv>
+#include <array>
 
 #ifdef CWDEBUG
 NAMESPACE_DEBUG_CHANNELS_START
@@ -52,397 +52,81 @@ char const* element_to_string(elements element)
   AI_NEVER_REACHED
 }
 
-template<elements enum_type>
-class Element;
-
-class ElementBase2 : public ElementBase
-{
- protected:
-  using ElementBase::ElementBase;
-
-  std::string name() const override
-  {
-    ASSERT(0 <= m_id && m_id < number_of_elements);
-    return element_to_string(static_cast<elements>(m_id));
-  }
-
-  bool has_allowed_parent() override
-  {
-    return false;
-  }
-
-  void characters(Decoder const* UNUSED_ARG(decoder), std::string_view const& data) override
-  {
-    THROW_ALERT("Element <[ELEMENT]> contains unexpected characters \"[DATA]\"",
-        AIArgs("[ELEMENT]", name())("[DATA]", utils::print_using(data, utils::c_escape)));
-  }
-
-  void start_element(Decoder* UNUSED_ARG(decoder)) override { }
-  void end_element(Decoder* UNUSED_ARG(decoder)) override { }
-};
-
-class UnknownElement : public ElementBase2
-{
-  using ElementBase2::ElementBase2;
-
-  std::string name() const override
-  {
-    return "Unknown";
-  }
-};
-
-template<>
-class Element<element_methodResponse> : public ElementBase2
-{
-  using ElementBase2::ElementBase2;
-  bool has_allowed_parent() override
-  {
-    // <methodResponse> can only be the first tag.
-    return m_parent == nullptr;
-  }
-};
-
-template<>
-class Element<element_params> : public ElementBase2
-{
-  using ElementBase2::ElementBase2;
-  bool has_allowed_parent() override
-  {
-    // <params> can only occur in <methodResponse>.
-    return m_parent && m_parent->id() == element_methodResponse;
-  }
-};
-
-template<>
-class Element<element_param> : public ElementBase2
-{
-  using ElementBase2::ElementBase2;
-  bool has_allowed_parent() override
-  {
-    // <param> can only occur in <params>.
-    return m_parent && m_parent->id() == element_params;
-  }
-};
-
-template<>
-class Element<element_member> : public ElementBase2
-{
-  bool m_have_name;
-#ifdef CWDEBUG
-  std::string m_name;
-  data_type m_data_type;
-#endif
-
-  bool has_allowed_parent() override
-  {
-    // <member> can only occur in <struct>.
-    return m_parent && m_parent->id() == element_struct;
-  }
-
-  void end_element(Decoder* decoder) override
-  {
-    if (!m_have_name)
-      THROW_ALERT("<member> without <name>");
-#ifdef CWDEBUG
-    char const* struct_name = m_name.c_str();
-#endif
-    decoder->end_member();
-    Debug(decoder->got_member_type(m_data_type, struct_name));
-  }
-
- public:
-  Element(index_type id, ElementBase* parent) : ElementBase2(id, parent), m_have_name(false) { }
-
-  void have_name(CWDEBUG_ONLY(std::string name))
-  {
-    m_have_name = true;
-#ifdef CWDEBUG
-    m_name = std::move(name);
-#endif
-  }
-
-#ifdef CWDEBUG
-  void got_member_type(data_type type)
-  {
-    m_data_type = type;
-  }
-#endif
-};
-
-template<>
-class Element<element_data> : public ElementBase2
-{
-  using ElementBase2::ElementBase2;
-  bool has_allowed_parent() override
-  {
-    // <data> can only occur in <array>.
-    return m_parent && m_parent->id() == element_array;
-  }
-
-  void start_element(Decoder* decoder) override
-  {
-    decoder->got_data();
-  }
-};
-
-template<>
-class Element<element_value> : public ElementBase2
-{
-  using ElementBase2::ElementBase2;
-  bool has_allowed_parent() override
-  {
-    // <value> can only occur in <param>, <member> or <data>.
-    return m_parent &&
-      (m_parent->id() == element_param ||
-       m_parent->id() == element_member ||
-       m_parent->id() == element_data);
-  }
-
-#ifdef CWDEBUG
- public:
-  data_type m_data_type;
-
-  void end_element(Decoder* decoder) override
-  {
-    if (m_parent->id() == element_member)
-    {
-      Element<element_member>* parent = static_cast<Element<element_member>*>(m_parent);
-      parent->got_member_type(m_data_type);
-    }
-  }
-#endif
+// How an element is handled. Variables are the elements that contain a value.
+enum element_kind : uint8_t {
+  kind_not_allowed,
+  kind_plain,
+  kind_value,
+  kind_data_value,                      // A <value> in <data>: an element of an array.
+  kind_struct,
+  kind_member,
+  kind_name,
+  kind_array,
+  kind_data,
+  kind_variable
 };
 
-template<>
-class Element<element_struct> : public ElementBase2
-{
-  using ElementBase2::ElementBase2;
-  bool has_allowed_parent() override
-  {
-    // <struct> can only occur in <value>.
-    return m_parent && m_parent->id() == element_value;
-  }
-
-  void start_element(Decoder* decoder) override
-  {
-#ifdef CWDEBUG
-    Element<element_value>* parent = static_cast<Element<element_value>*>(m_parent);
-    parent->m_data_type = data_type_struct;
-#endif
-    decoder->start_struct();
-  }
-
-  void end_element(Decoder* decoder) override
-  {
-    decoder->end_struct();
-  }
-};
-
-template<>
-class Element<element_name> : public ElementBase2
-{
-  using ElementBase2::ElementBase2;
-  bool has_allowed_parent() override
-  {
-    // <name> can only occur in <member>.
-    return m_parent && m_parent->id() == element_member;
-  }
+using transitions_type = std::array<std::array<element_kind, number_of_elements>, number_of_elements + 1>;
 
-  std::string m_name;
-  void characters(Decoder const* decoder, std::string_view const& data) override
-  {
-    if (data.size() > 256)
-      THROW_ALERT("Refusing to allocate a <name> of more than 256 characters (\"[DATA]\")",
-          AIArgs("[DATA]", utils::print_using(data, utils::c_escape)));
-    m_name = data;
-  }
-
-  void end_element(Decoder* decoder) override
-  {
-    if (m_name.empty())
-      THROW_ALERT("Empty element <name>");
-    decoder->start_member(m_name);
-    Element<element_member>* parent = static_cast<Element<element_member>*>(m_parent);
-    parent->have_name(CWDEBUG_ONLY(m_name));
-  }
-};
-
-class ElementVariable : public ElementBase2
+// The kind of each child element (column) that is allowed in a parent element (row).
+// Row 0 is for the root element; row parent + 1 for the children of parent.
+constexpr transitions_type make_transitions()
 {
-  bool has_allowed_parent() override
-  {
-    // Variables (see below) can only occur in <value>.
-    return m_parent && m_parent->id() == element_value;
-  }
-
-  void end_element(Decoder* decoder) override
-  {
-    if (!m_received_characters)
-      characters(decoder, {});
-  }
-
-  void characters(Decoder const* decoder, std::string_view const& data) override
-  {
-    m_received_characters = true;
-    decoder->got_characters(data);
-  }
-
- protected:
-  bool m_received_characters;
-
- public:
-  ElementVariable(index_type id, ElementBase* parent) : ElementBase2(id, parent), m_received_characters(false) { }
-};
-
-template<>
-class Element<element_array> : public ElementVariable
-{
-  using ElementVariable::ElementVariable;
-
-  void start_element(Decoder* decoder) override
-  {
-#ifdef CWDEBUG
-    Element<element_value>* parent = static_cast<Element<element_value>*>(m_parent);
-    parent->m_data_type = data_type_array;
-#endif
-    decoder->start_array();
-  }
-
-  void characters(Decoder const* decoder, std::string_view const& data) override
-  {
-    // <array> is not allowed to contain characters.
-    THROW_ALERT("Element <array> contains unexpected characters \"[DATA]\"",
-        AIArgs("[DATA]", utils::print_using(data, utils::c_escape)));
-  }
-
-  void end_element(Decoder* decoder) override
-  {
-    // <array> is not allowed to contain characters.
-    decoder->end_array();
-  }
-};
-
-template<>
-class Element<element_base64> : public ElementVariable
-{
-  using ElementVariable::ElementVariable;
-
-#ifdef CWDEBUG
-  void start_element(Decoder* decoder) override
-  {
-    Element<element_value>* parent = static_cast<Element<element_value>*>(m_parent);
-    parent->m_data_type = data_type_base64;
-  }
-#endif
-};
-
-template<>
-class Element<element_boolean> : public ElementVariable
-{
-  using ElementVariable::ElementVariable;
-
-#ifdef CWDEBUG
-  void start_element(Decoder* decoder) override
-  {
-    Element<element_value>* parent = static_cast<Element<element_value>*>(m_parent);
-    parent->m_data_type = data_type_boolean;
-  }
-#endif
-};
+  transitions_type transitions{};
+  auto allow = [&transitions](int parent, elements child, element_kind kind){ transitions[parent + 1][child] = kind; };
+  // <methodResponse> can only be the first tag.
+  allow(-1, element_methodResponse, kind_plain);
+  allow(element_methodResponse, element_params, kind_plain);
+  allow(element_params, element_param, kind_plain);
+  // <value> can only occur in <param>, <member> or <data>.
+  allow(element_param, element_value, kind_value);
+  allow(element_member, element_value, kind_value);
+  allow(element_data, element_value, kind_data_value);
+  allow(element_value, element_struct, kind_struct);
+  allow(element_struct, element_member, kind_member);
+  allow(element_member, element_name, kind_name);
+  allow(element_value, element_array, kind_array);
+  allow(element_array, element_data, kind_data);
+  for (elements variable : { element_base64, element_boolean, element_dateTime_iso8601, element_double, element_int, element_i4, element_string })
+    allow(element_value, variable, kind_variable);
+  return transitions;
+}
 
-template<>
-class Element<element_dateTime_iso8601> : public ElementVariable
-{
-  using ElementVariable::ElementVariable;
+constexpr transitions_type transitions = make_transitions();
 
 #ifdef CWDEBUG
-  void start_element(Decoder* decoder) override
-  {
-    Element<element_value>* parent = static_cast<Element<element_value>*>(m_parent);
-    parent->m_data_type = data_type_datetime;
-  }
-#endif
-};
-
-template<>
-class Element<element_double> : public ElementVariable
+data_type data_type_of(index_type element_id)
 {
-  using ElementVariable::ElementVariable;
-
-#ifdef CWDEBUG
-  void start_element(Decoder* decoder) override
-  {
-    Element<element_value>* parent = static_cast<Element<element_value>*>(m_parent);
-    parent->m_data_type = data_type_double;
-  }
-#endif
-};
-
-// A signed integer of 32 bytes.
-class ElementInt : public ElementVariable
-{
-  using ElementVariable::ElementVariable;
-
-#ifdef CWDEBUG
-  void start_element(Decoder* decoder) override
-  {
-    Element<element_value>* parent = static_cast<Element<element_value>*>(m_parent);
-    parent->m_data_type = data_type_int;
-  }
+  switch (element_id)
+  {
+    case element_struct:
+      return data_type_struct;
+    case element_array:
+      return data_type_array;
+    case element_base64:
+      return data_type_base64;
+    case element_boolean:
+      return data_type_boolean;
+    case element_dateTime_iso8601:
+      return data_type_datetime;
+    case element_double:
+      return data_type_double;
+    case element_string:
+      return data_type_string;
+  }
+  return data_type_int;
+}
 #endif
-};
-
-template<>
-class Element<element_int> : public ElementInt
-{
-  using ElementInt::ElementInt;
-};
-
-template<>
-class Element<element_i4> : public ElementInt
-{
-  using ElementInt::ElementInt;
-};
 
-template<>
-class Element<element_string> : public ElementVariable
+std::string_view Decoder::element_name(index_type element_id) const
 {
-  using ElementVariable::ElementVariable;
-
+  if (0 <= element_id && element_id < static_cast<index_type>(number_of_elements))
+    return element_to_string(static_cast<elements>(element_id));
 #ifdef CWDEBUG
-  void start_element(Decoder* decoder) override
-  {
-    Element<element_value>* parent = static_cast<Element<element_value>*>(m_parent);
-    parent->m_data_type = data_type_string;
-  }
+  return name_of(element_id);
+#else
+  return "Unknown";
 #endif
-};
-
-#define SIZEOF_ELEMENT_COMMA(el) sizeof(Element<element_##el>),
-
-constexpr size_t largest_size = std::max({FOREACH_ELEMENT(SIZEOF_ELEMENT_COMMA)});
-
-utils::NodeMemoryPool pool(128, largest_size);
-
-#define XMLRPC_CASE_CREATE(el) \
-  case element_##el: \
-    return new(pool) Element<element_##el>(element_##el, parent);
-
-ElementBase* create_element(Decoder::index_type element, ElementBase* parent)
-{
-  switch (element)
-  {
-    FOREACH_ELEMENT(XMLRPC_CASE_CREATE)
-    default:
-      return new UnknownElement{element, parent};
-  }
-}
-
-ElementBase* destroy_element(ElementBase* current_element)
-{
-  ElementBase* parent = current_element->parent();
-  delete current_element;
-  return parent;
 }
 
 void Decoder::start_document(size_t content_length, std::string version, std::string encoding)
@@ -455,37 +139,131 @@ void Decoder::start_document(size_t content_length, std::string version, std::st
     add(i, name);
   }
 
-  m_current_element = nullptr;
+  // In case decoding the previous document failed.
+  m_open_elements.clear();
 }
 
 void Decoder::end_document()
 {
   DoutEntering(dc::xmlrpc, "Decoder::end_document()");
+  // All elements should have been closed already.
+  ASSERT(m_open_elements.empty());
 }
 
 void Decoder::start_element(index_type element_id)
 {
   DoutEntering(dc::xmlrpc, "Decoder::start_element(" << element_id << " [" << name_of(element_id) << "])");
 
-  xmlrpc::ElementBase* parent = m_current_element;
-  m_current_element = create_element(element_id, parent);
-  if (!m_current_element->has_allowed_parent())
+  size_t const row = m_open_elements.empty() ? 0 : m_open_elements.back().m_id + 1;
+  element_kind const kind = 0 <= element_id && element_id < static_cast<index_type>(number_of_elements) ? transitions[row][element_id] : kind_not_allowed;
+  if (kind == kind_not_allowed)
+  {
+    if (row == 0)
+      THROW_ALERT("Unexpected root element <[CHILD]>", AIArgs("[CHILD]", element_name(element_id)));
     THROW_ALERT("Element <[PARENT]> is not expected to have child element <[CHILD]>",
-        AIArgs("[PARENT]", parent->name())("[CHILD]", m_current_element->name()));
-  m_current_element->start_element(this);
+        AIArgs("[PARENT]", element_name(m_open_elements.back().m_id))("[CHILD]", element_name(element_id)));
+  }
+
+#ifdef CWDEBUG
+  if (kind == kind_struct || kind == kind_array || kind == kind_variable)
+    m_open_elements.back().m_data_type = data_type_of(element_id);
+#endif
+  m_open_elements.push_back({element_id, kind, false});
+
+  switch (kind)
+  {
+    case kind_struct:
+      start_struct();
+      break;
+    case kind_array:
+      start_array();
+      break;
+    case kind_data_value:
+      got_data();
+      break;
+    case kind_name:
+      m_member_name.clear();
+      break;
+    default:
+      break;
+  }
 }
 
 void Decoder::end_element(index_type element_id)
 {
   DoutEntering(dc::xmlrpc, "Decoder::end_element(" << element_id << " [" << name_of(element_id) << "])");
-  m_current_element->end_element(this);
-  m_current_element = destroy_element(m_current_element);
+
+  OpenElement& element = m_open_elements.back();
+  switch (element.m_kind)
+  {
+    case kind_struct:
+      end_struct();
+      break;
+    case kind_array:
+      end_array();
+      break;
+    case kind_member:
+    {
+      if (!element.m_flag)
+        THROW_ALERT("<member> without <name>");
+      end_member();
+      Debug(got_member_type(element.m_data_type, element.m_name.c_str()));
+      break;
+    }
+    case kind_name:
+    {
+      if (m_member_name.empty())
+        THROW_ALERT("Empty element <name>");
+      start_member(m_member_name);
+      OpenElement& member = m_open_elements[m_open_elements.size() - 2];
+      member.m_flag = true;
+      Debug(member.m_name = m_member_name);
+      break;
+    }
+    case kind_variable:
+      if (!element.m_flag)
+        got_characters({});
+      break;
+    case kind_data_value:
+      got_data_value_end();
+      break;
+    case kind_data:
+      got_data_end();
+      break;
+#ifdef CWDEBUG
+    case kind_value:
+    {
+      OpenElement& parent = m_open_elements[m_open_elements.size() - 2];
+      if (parent.m_kind == kind_member)
+        parent.m_data_type = element.m_data_type;
+      break;
+    }
+#endif
+  }
+  m_open_elements.pop_back();
 }
 
 void Decoder::characters(std::string_view const& data)
 {
   DoutEntering(dc::xmlrpc, "Decoder::characters(\"" << buf2str(data.data(), data.size()) << "\")");
-  m_current_element->characters(this, data);
+
+  OpenElement& element = m_open_elements.back();
+  switch (element.m_kind)
+  {
+    case kind_name:
+      if (data.size() > 256)
+        THROW_ALERT("Refusing to allocate a <name> of more than 256 characters (\"[DATA]\")",
+            AIArgs("[DATA]", utils::print_using(data, utils::c_escape)));
+      m_member_name = data;
+      break;
+    case kind_variable:
+      element.m_flag = true;
+      got_characters(data);
+      break;
+    default:
+      THROW_ALERT("Element <[ELEMENT]> contains unexpected characters \"[DATA]\"",
+          AIArgs("[ELEMENT]", element_name(element.m_id))("[DATA]", utils::print_using(data, utils::c_escape)));
+  }
 }
 
 } // namespace evio::protocol::xmlrpc
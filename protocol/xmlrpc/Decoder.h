@@ -2,56 +2,43 @@
 
 #include "evio/protocol/UTF8_SAX_Decoder.h"
 #include "ElementDecoder.h"
-#include <stack>
+#include <boost/container/small_vector.hpp>
+#include <cstdint>
+#include <string>
 
 namespace evio::protocol::xmlrpc {
 
-class Decoder;
-
-class ElementBase
-{
- public:
-  using index_type = evio::protocol::UTF8_SAX_Decoder::index_type;
-
- protected:
-  index_type m_id;
-  ElementBase* m_parent;
-
- public:
-  ElementBase(index_type id, ElementBase* parent) : m_id(id), m_parent(parent) { }
-  virtual ~ElementBase() { }
-  // Objects derived from ElementBase must be allocated with:
-  // utils::NodeMemoryPool pool(128, sizeof(LargestDerivedClass));
-  // DerivedClass* foo = new(pool) DerivedClass(...constructor args...);        // Allocate memory from memory pool and construct object.
-  // delete foo;
-  void operator delete(void* ptr) { utils::NodeMemoryPool::static_free(ptr); }
-
-  index_type id() { return m_id; }
-  ElementBase* parent() { return m_parent; }
-
-  virtual std::string name() const = 0;
-  virtual bool has_allowed_parent() = 0;
-  virtual void start_element(Decoder* decoder) = 0;
-  virtual void characters(Decoder const* decoder, std::string_view const& data) = 0;
-  virtual void end_element(Decoder* decoder) = 0;
-};
-
 class Decoder : public evio::protocol::UTF8_SAX_Decoder
 {
  private:
   struct DecoderPtr { ElementDecoder* ptr; bool need_destroy; };
   DecoderPtr m_current_xml_rpc_element_decoder;
-  std::stack<DecoderPtr> m_xml_rpc_response_stack;
-  ElementBase* m_current_element;
+  boost::container::small_vector<DecoderPtr, 32> m_xml_rpc_response_stack;
+
+  // An element that is currently open.
+  struct OpenElement
+  {
+    index_type m_id;
+    uint8_t m_kind;                     // How the element is handled (an element_kind, see Decoder.cxx).
+    bool m_flag;                        // <member>: a <name> was seen. Variables: characters were received.
+#ifdef CWDEBUG
+    data_type m_data_type;              // <value>, <member>: the type of the value.
+    std::string m_name;                 // <member>: its name.
+#endif
+  };
+  boost::container::small_vector<OpenElement, 32> m_open_elements;
+  std::string m_member_name;            // The characters of the current <name>.
 
   void restore_current_xml_rpc_element_decoder()
   {
     if (m_current_xml_rpc_element_decoder.need_destroy)
       m_current_xml_rpc_element_decoder.ptr->destroy_member_decoder();
-    m_current_xml_rpc_element_decoder = m_xml_rpc_response_stack.top();
-    m_xml_rpc_response_stack.pop();
+    m_current_xml_rpc_element_decoder = m_xml_rpc_response_stack.back();
+    m_xml_rpc_response_stack.pop_back();
   }
 
+  std::string_view element_name(index_type element_id) const;
+
  protected:
   void start_document(size_t content_length, std::string version, std::string encoding) final;
   void end_document() final;
@@ -74,13 +61,13 @@ class Decoder : public evio::protocol::UTF8_SAX_Decoder
   {
     // Call init after using the default constructor.
     ASSERT(m_current_xml_rpc_element_decoder.ptr != nullptr);
-    m_xml_rpc_response_stack.push(m_current_xml_rpc_element_decoder);
+    m_xml_rpc_response_stack.push_back(m_current_xml_rpc_element_decoder);
     m_current_xml_rpc_element_decoder = { m_current_xml_rpc_element_decoder.ptr->get_struct_decoder(), false };
   }
 
   void start_member(std::string_view const& name)
   {
-    m_xml_rpc_response_stack.push(m_current_xml_rpc_element_decoder);
+    m_xml_rpc_response_stack.push_back(m_current_xml_rpc_element_decoder);
     m_current_xml_rpc_element_decoder = { m_current_xml_rpc_element_decoder.ptr->create_member_decoder(name), true };
   }
 
@@ -103,7 +90,7 @@ class Decoder : public evio::protocol::UTF8_SAX_Decoder
 
   void start_array()
   {
-    m_xml_rpc_response_stack.push(m_current_xml_rpc_element_decoder);
+    m_xml_rpc_response_stack.push_back(m_current_xml_rpc_element_decoder);
     m_current_xml_rpc_element_decoder = { m_current_xml_rpc_element_decoder.ptr->get_array_decoder(), false };
   }
 
@@ -114,13 +101,23 @@ class Decoder : public evio::protocol::UTF8_SAX_Decoder
 
   void got_characters(std::string_view const& data) const
   {
-    m_current_xml_rpc_element_decoder.ptr->got_characters(data);
+    m_current_xml_rpc_element_decoder.ptr->got_characters(data, *this);
   }
 
   void got_data()
   {
     m_current_xml_rpc_element_decoder.ptr->got_data();
   }
+
+  void got_data_value_end()
+  {
+    m_current_xml_rpc_element_decoder.ptr->got_data_value_end();
+  }
+
+  void got_data_end()
+  {
+    m_current_xml_rpc_element_decoder.ptr->got_data_end();
+  }
 };
 
 } // namespace evio::protocol::xmlrpc
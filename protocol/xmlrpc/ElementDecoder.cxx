@@ -1,6 +1,7 @@
 #include "sys.h"
 #include "IgnoreElement.h"
 #include "ArrayOfStructDecoder.h"
+#include "StreamedArrayDecoder.h"
 #include "utils/AIAlert.h"
 #include "utils/print_using.h"
 #include "utils/c_escape.h"
@@ -55,20 +56,21 @@ void ElementDecoder::destroy_member_decoder()
 }
 
 // Called from xmlrpc::Decoder::got_characters called from ElementVariable::characters.
-void ElementDecoder::got_characters(std::string_view const& data)
+void ElementDecoder::got_characters(std::string_view const& data, UTF8_SAX_Decoder const& UNUSED_ARG(source))
 {
   THROW_ALERT("Unexpected characters [[DATA]] in element", AIArgs("[DATA]", utils::print_using(data, utils::c_escape)));
 }
 
+// Called from xmlrpc::Decoder::got_data at the start of every <value> in <data>.
 void ElementDecoder::got_data()
 {
   // Implement got_data in derived class.
   ASSERT(false);
 }
 
-// ArrayOfStructDecoder is the largest.
+// A StreamedArrayDecoder around an ArrayOfStructDecoder is the largest.
 struct Dummy { enum members { one_ }; };
-static constexpr size_t largest_size = sizeof(ArrayOfStructDecoder<Dummy>);
+static constexpr size_t largest_size = sizeof(StreamedArrayDecoder<Dummy, ArrayOfStructDecoder<Dummy>>);
 utils::NodeMemoryPool ElementDecoder::s_pool(8, largest_size);
 
 } // namespace evio::protocol::xmlrpc
@@ -6,6 +6,10 @@
 #include <iosfwd>
 #include "debug.h"
 
+namespace evio::protocol {
+class UTF8_SAX_Decoder;
+} // namespace evio::protocol
+
 namespace evio::protocol::xmlrpc {
 
 enum data_type
@@ -31,8 +35,12 @@ class ElementDecoder
   // get_array_decoder never really allocates a new decoder (always returns 'this').
   virtual ElementDecoder* get_array_decoder();
 
-  virtual void got_characters(std::string_view const& data);
+  // source can be used to keep referring to the received data (see LazyString).
+  virtual void got_characters(std::string_view const& data, UTF8_SAX_Decoder const& source);
+  // Called at the start and the end of every <value> in the <data> of an <array>, and at the end of the <data>.
   virtual void got_data();
+  virtual void got_data_value_end() { }
+  virtual void got_data_end() { }
 #ifdef CWDEBUG
   virtual void got_member_type(xmlrpc::data_type type, char const* member_name)
   {
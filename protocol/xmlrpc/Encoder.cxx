@@ -1,26 +1,87 @@
 #include "sys.h"
 #include "Encoder.h"
 #include "Request.h"
+#include "Multicall.h"
+#include "Writer.h"
 #include "debug.h"
 
 namespace evio::protocol::xmlrpc {
 
 Encoder& operator<<(Encoder& encoder, Request const& request)
 {
-  // Write XML RPC header.
-  encoder.m_output <<
-    "<?xml version=\"1.0\"?>"
-    "<methodCall>"
-      "<methodName>" << request.method_name() << "</methodName>"
-      "<params>";
+  auto param = request.begin();
+  bool const has_params = param != request.end();
+  std::string_view first_static_prefix = param == request.end() ? std::string_view{} : (*param)->static_prefix();
+
+  // Requests of the same method usually follow each other; reuse the rendered prefix.
+  if (request.method_name() != encoder.m_prefix_method_name || first_static_prefix.data() != encoder.m_prefix_static_prefix ||
+      has_params != encoder.m_prefix_has_params || encoder.m_prefix.empty())
+  {
+    encoder.m_prefix_method_name = request.method_name();
+    encoder.m_prefix_static_prefix = first_static_prefix.data();
+    encoder.m_prefix_has_params = has_params;
+    // Write XML RPC header.
+    encoder.m_prefix =
+      "<?xml version=\"1.0\"?>"
+      "<methodCall>"
+        "<methodName>";
+    encoder.m_prefix += request.method_name();
+    encoder.m_prefix += "</methodName>"
+        "<params>";
+    if (has_params)
+    {
+      encoder.m_prefix += "<param>";
+      encoder.m_prefix += first_static_prefix;
+    }
+  }
 
-  for(auto&& param : request)
-    param->write_param(encoder.m_output);
+  Writer writer(encoder.m_output);
+  writer.write(encoder.m_prefix);
+  for (; param != request.end(); ++param)
+  {
+    if (param != request.begin())
+    {
+      writer.write("<param>");
+      writer.write((*param)->static_prefix());
+    }
+    (*param)->write_param(writer);
+    writer.write("</param>");
+  }
 
   // Write XML RPC trailer.
-  encoder.m_output <<
+  writer.write(
       "</params>"
-    "</methodCall>";
+    "</methodCall>");
+
+  return encoder;
+}
+
+Encoder& operator<<(Encoder& encoder, MulticallBatch const& batch)
+{
+  Writer writer(encoder.m_output);
+  writer.write(
+    "<?xml version=\"1.0\"?>"
+    "<methodCall>"
+      "<methodName>system.multicall</methodName>"
+      "<params><param><value><array><data>");
+
+  // Each call is a struct with its methodName and an array with its params.
+  for (MulticallBatch::Call const& call : batch.m_calls)
+  {
+    writer.write("<value><struct><member><name>methodName</name><value><string>");
+    writer.write_escaped(call.m_request->method_name());
+    writer.write("</string></value></member><member><name>params</name><value><array><data>");
+    for (RequestParam const* param : *call.m_request)
+    {
+      writer.write(param->static_prefix());
+      param->write_param(writer);
+    }
+    writer.write("</data></array></value></member></struct></value>");
+  }
+
+  writer.write(
+      "</data></array></value></param></params>"
+    "</methodCall>");
 
   return encoder;
 }
@@ -1,20 +1,31 @@
 #pragma once
 
 #include <iosfwd>
+#include <string>
 
 namespace evio::protocol::xmlrpc {
 
 class Request;
+class MulticallBatch;
 
 class Encoder
 {
  private:
   std::ostream& m_output;
 
+  // Everything up till the first variable value of the last encoded request:
+  // the header, <methodName> and the static_prefix() of the first parameter.
+  std::string m_prefix;
+  std::string m_prefix_method_name;     // The method name of that request.
+  char const* m_prefix_static_prefix;   // The data of the static_prefix() of its first parameter.
+  bool m_prefix_has_params;             // Whether that request had any parameters (m_prefix then ends on "<param>").
+
  public:
-  Encoder(std::ostream& output) : m_output(output) { }
+  Encoder(std::ostream& output) : m_output(output), m_prefix_static_prefix(nullptr), m_prefix_has_params(false) { }
 
   friend Encoder& operator<<(Encoder& encoder, Request const& request);
+  // Encode all requests of batch as a single system.multicall.
+  friend Encoder& operator<<(Encoder& encoder, MulticallBatch const& batch);
 };
 
 }// namespace evio::protocol::xmlrpc
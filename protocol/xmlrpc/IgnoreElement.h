@@ -17,8 +17,10 @@ class IgnoreElement : public ElementDecoder
 #ifdef CWDEBUG
   void got_member_type(xmlrpc::data_type type, char const* struct_name) override { Dout(dc::notice, "got_member_type(" << type << ", \"" << struct_name << "\") ignored"); }
 #endif
-  void got_characters(std::string_view const& data) override { Dout(dc::notice, "got_characters(" << libcwd::buf2str(data.data(), data.size()) << ") ignored"); }
+  void got_characters(std::string_view const& data, UTF8_SAX_Decoder const&) override { Dout(dc::notice, "got_characters(" << libcwd::buf2str(data.data(), data.size()) << ") ignored"); }
   void got_data() override { Dout(dc::notice, "got_data() ignored"); }
+  void got_data_value_end() override { }
+  void got_data_end() override { }
 
  public:
   static IgnoreElement s_ignore_element;
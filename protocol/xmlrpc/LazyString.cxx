@@ -0,0 +1,38 @@
+#include "sys.h"
+#include "LazyString.h"
+#include "evio/protocol/UTF8_SAX_Decoder.h"
+#include <iostream>
+#include "debug.h"
+
+namespace evio::protocol::xmlrpc {
+
+void LazyString::assign_from_raw(MsgBlock&& raw)
+{
+  m_raw = std::move(raw);
+  m_string.clear();
+  m_unescaped = false;
+}
+
+void LazyString::unescape() const
+{
+  UTF8_SAX_Decoder::append_unescaped(m_raw.view(), m_string);
+  m_unescaped = true;
+}
+
+std::ostream& operator<<(std::ostream& os, LazyString const& lazy_string)
+{
+  return os << lazy_string.view();
+}
+
+template<>
+void initialize(LazyString& lazy_string, std::string_view const& data, UTF8_SAX_Decoder const& source)
+{
+  // Copy the value if it isn't in a MemoryBlock (or when called for an empty variable).
+  MsgBlock raw = source.raw_characters_block();
+  if (raw.has_memory_block())
+    lazy_string.assign_from_raw(std::move(raw));
+  else
+    lazy_string.assign(data);
+}
+
+} // namespace evio::protocol::xmlrpc
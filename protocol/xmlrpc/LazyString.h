@@ -0,0 +1,79 @@
+#pragma once
+
+#include "initialize.h"
+#include "evio/StreamBuf.h"
+#include <string>
+#include <string_view>
+#include <iosfwd>
+
+namespace evio::protocol::xmlrpc {
+
+// A member type to use instead of std::string for <string> values that are
+// often not (all) used.
+//
+// Instead of copying the value, LazyString keeps a reference to the receive
+// buffer that contains it. References (&amp; etc) are only replaced when
+// the value is accessed for the first time.
+//
+// Note that this keeps the whole MemoryBlock of the receive buffer alive for
+// as long as the LazyString exists; call str() to get a copy of values that
+// must be kept for a long time. Accessing the value is not thread-safe.
+//
+class LazyString
+{
+ private:
+  MsgBlock m_raw;                       // The value as received, if it is in a MemoryBlock.
+  mutable std::string m_string;         // The value, when m_raw contains references or isn't used.
+  mutable bool m_unescaped;             // Set when m_string contains the value.
+
+ public:
+  LazyString() : m_raw(std::string_view{}), m_unescaped(true) { }
+  LazyString(LazyString const& lazy_string) : m_raw(std::string_view{}), m_string(lazy_string.m_string), m_unescaped(lazy_string.m_unescaped) { m_raw = lazy_string.m_raw; }
+  LazyString(LazyString&& lazy_string) = default;
+  LazyString& operator=(LazyString const& lazy_string) = default;
+  LazyString& operator=(LazyString&& lazy_string) = default;
+
+  // Assign the value as received (with references still in it).
+  void assign_from_raw(MsgBlock&& raw);
+
+  // Assign an already decoded value.
+  void assign(std::string_view value)
+  {
+    m_raw = std::string_view{};
+    m_string = value;
+    m_unescaped = true;
+  }
+
+  std::string_view view() const
+  {
+    if (m_unescaped)
+      return m_string;
+    if (m_raw.view().find('&') == std::string_view::npos)
+      return m_raw.view();
+    unescape();
+    return m_string;
+  }
+
+  std::string str() const { return std::string{view()}; }
+  bool empty() const { return view().empty(); }
+  size_t size() const { return view().size(); }
+
+  friend bool operator==(LazyString const& lhs, std::string_view rhs) { return lhs.view() == rhs; }
+  friend bool operator!=(LazyString const& lhs, std::string_view rhs) { return lhs.view() != rhs; }
+
+  friend std::ostream& operator<<(std::ostream& os, LazyString const& lazy_string);
+
+ private:
+  void unescape() const;
+};
+
+template<>
+inline void initialize(LazyString& lazy_string, std::string_view const& data)
+{
+  lazy_string.assign(data);
+}
+
+template<>
+void initialize(LazyString& lazy_string, std::string_view const& data, UTF8_SAX_Decoder const& source);
+
+} // namespace evio::protocol::xmlrpc
@@ -9,11 +9,11 @@ namespace evio::protocol::xmlrpc {
 template<typename T>
 class MemberDecoder : public DecoderBase<T>
 {
-  void got_characters(std::string_view const& data) override
+  void got_characters(std::string_view const& data, UTF8_SAX_Decoder const& source) override
   {
     // If the following results in the compile error: no matching function for call to 'initialize',
     // where T = YourType, then you need to overload xmlrpc::initialize(YourType&, std::string_view const& data).
-    initialize(this->m_member, data);
+    initialize(this->m_member, data, source);
   }
 
  public:
@@ -0,0 +1,197 @@
+#include "sys.h"
+#include "MsgPackReader.h"
+#include "utils/AIAlert.h"
+#include <cstring>
+#include <limits>
+#include "debug.h"
+
+namespace evio::protocol::xmlrpc {
+
+//static
+void MsgPackReader::throw_truncated()
+{
+  THROW_ALERT("Truncated MessagePack data");
+}
+
+//static
+void MsgPackReader::throw_unexpected(uint8_t type, char const* expected)
+{
+  THROW_ALERT("Unexpected MessagePack type [TYPE], expected [EXPECTED]",
+      AIArgs("[TYPE]", static_cast<int>(type))("[EXPECTED]", expected));
+}
+
+// Read the size of a str, bin, array or map that starts with type; type8 is zero if the type has no 8-bit variant.
+size_t MsgPackReader::read_size(uint8_t type, uint8_t fix, uint8_t fix_mask, uint8_t type8, uint8_t type16, char const* what)
+{
+  if (fix_mask && (type & ~fix_mask) == fix)
+    return type & fix_mask;
+  if (type8 && type == type8)
+    return read_big_endian(1);
+  if (type == type16)
+    return read_big_endian(2);
+  if (type == type16 + 1)
+    return read_big_endian(4);
+  throw_unexpected(type, what);
+}
+
+size_t MsgPackReader::read_array_header()
+{
+  return read_size(read_byte(), 0x90, 0x0f, 0, 0xdc, "an array");
+}
+
+size_t MsgPackReader::read_map_header()
+{
+  return read_size(read_byte(), 0x80, 0x0f, 0, 0xde, "a map");
+}
+
+std::string_view MsgPackReader::read_str()
+{
+  size_t size = read_size(read_byte(), 0xa0, 0x1f, 0xd9, 0xda, "a string");
+  return {reinterpret_cast<char const*>(read_bytes(size)), size};
+}
+
+std::string_view MsgPackReader::read_bin()
+{
+  size_t size = read_size(read_byte(), 0, 0, 0xc4, 0xc5, "binary data");
+  return {reinterpret_cast<char const*>(read_bytes(size)), size};
+}
+
+int64_t MsgPackReader::read_integer()
+{
+  uint8_t type = read_byte();
+  if (type < 0x80 || type >= 0xe0)      // Positive or negative fixint.
+    return static_cast<int8_t>(type);
+  switch (type)
+  {
+    case 0xcc: case 0xcd: case 0xce:    // uint 8, 16 and 32.
+      return read_big_endian(1 << (type - 0xcc));
+    case 0xcf:                          // uint 64.
+    {
+      uint64_t value = read_big_endian(8);
+      if (value > static_cast<uint64_t>(std::numeric_limits<int64_t>::max()))
+        THROW_ALERT("MessagePack integer [VALUE] is out of range", AIArgs("[VALUE]", value));
+      return value;
+    }
+    case 0xd0:                          // int 8.
+      return static_cast<int8_t>(read_big_endian(1));
+    case 0xd1:                          // int 16.
+      return static_cast<int16_t>(read_big_endian(2));
+    case 0xd2:                          // int 32.
+      return static_cast<int32_t>(read_big_endian(4));
+    case 0xd3:                          // int 64.
+      return static_cast<int64_t>(read_big_endian(8));
+  }
+  throw_unexpected(type, "an integer");
+}
+
+double MsgPackReader::read_double()
+{
+  if (m_ptr != m_end && (*m_ptr == 0xca || *m_ptr == 0xcb))
+  {
+    if (*m_ptr++ == 0xca)
+    {
+      uint32_t bits = read_big_endian(4);
+      float value;
+      std::memcpy(&value, &bits, sizeof(value));
+      return value;
+    }
+    uint64_t bits = read_big_endian(8);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+  return read_integer();
+}
+
+bool MsgPackReader::read_bool()
+{
+  uint8_t type = read_byte();
+  if ((type & ~1) != 0xc2)
+    throw_unexpected(type, "a boolean");
+  return type & 1;
+}
+
+DateTime MsgPackReader::read_timestamp()
+{
+  uint8_t type = read_byte();
+  size_t size;
+  if (type == 0xd6 || type == 0xd7)     // fixext 4 and 8.
+    size = type == 0xd6 ? 4 : 8;
+  else if (type == 0xc7)                // ext 8.
+    size = read_big_endian(1);
+  else
+    throw_unexpected(type, "a timestamp");
+  if (read_byte() != 0xff)
+    THROW_ALERT("Expected a MessagePack timestamp extension");
+  switch (size)
+  {
+    case 4:
+      return static_cast<std::time_t>(read_big_endian(4));
+    case 8:
+      // 30 bits of nanoseconds followed by 34 bits of seconds.
+      return static_cast<std::time_t>(read_big_endian(8) & 0x3ffffffffULL);
+    case 12:
+      read_bytes(4);
+      return static_cast<std::time_t>(read_big_endian(8));
+  }
+  THROW_ALERT("Invalid MessagePack timestamp of [SIZE] bytes", AIArgs("[SIZE]", size));
+}
+
+void MsgPackReader::skip()
+{
+  // The number of values that still have to be skipped.
+  size_t count = 1;
+  do
+  {
+    uint8_t type = read_byte();
+    --count;
+    if (type < 0x80 || type >= 0xe0)    // Positive or negative fixint.
+      continue;
+    if (type < 0x90)                    // fixmap.
+      count += 2 * (type & 0x0f);
+    else if (type < 0xa0)               // fixarray.
+      count += type & 0x0f;
+    else if (type < 0xc0)               // fixstr.
+      read_bytes(type & 0x1f);
+    else
+    {
+      switch (type)
+      {
+        case 0xc0: case 0xc2: case 0xc3:        // nil, false, true.
+          break;
+        case 0xc4: case 0xc5: case 0xc6:        // bin 8, 16 and 32.
+          read_bytes(read_big_endian(1 << (type - 0xc4)));
+          break;
+        case 0xd9: case 0xda: case 0xdb:        // str 8, 16 and 32.
+          read_bytes(read_big_endian(1 << (type - 0xd9)));
+          break;
+        case 0xc7: case 0xc8: case 0xc9:        // ext 8, 16 and 32.
+          read_bytes(read_big_endian(1 << (type - 0xc7)) + 1);
+          break;
+        case 0xca: case 0xcb:                   // float 32 and 64.
+          read_bytes(4 << (type - 0xca));
+          break;
+        case 0xcc: case 0xcd: case 0xce: case 0xcf:     // uint 8, 16, 32 and 64.
+          read_bytes(1 << (type - 0xcc));
+          break;
+        case 0xd0: case 0xd1: case 0xd2: case 0xd3:     // int 8, 16, 32 and 64.
+          read_bytes(1 << (type - 0xd0));
+          break;
+        case 0xd4: case 0xd5: case 0xd6: case 0xd7: case 0xd8:  // fixext 1, 2, 4, 8 and 16.
+          read_bytes((1 << (type - 0xd4)) + 1);
+          break;
+        case 0xdc: case 0xdd:                   // array 16 and 32.
+          count += read_big_endian(2 << (type - 0xdc));
+          break;
+        case 0xde: case 0xdf:                   // map 16 and 32.
+          count += 2 * read_big_endian(2 << (type - 0xde));
+          break;
+        default:
+          throw_unexpected(type, "a value");
+      }
+    }
+  }
+  while (count > 0);
+}
+
+} // namespace evio::protocol::xmlrpc
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "evio/DateTime.h"
+#include <cstdint>
+#include <string_view>
+
+namespace evio::protocol::xmlrpc {
+
+// Reads MessagePack values from a contiguous buffer (see write_msgpack.h and read_msgpack.h).
+// Malformed or truncated data causes an AIAlert::Error to be thrown.
+class MsgPackReader
+{
+ private:
+  unsigned char const* m_ptr;
+  unsigned char const* m_end;
+
+ public:
+  MsgPackReader(std::string_view data) :
+    m_ptr(reinterpret_cast<unsigned char const*>(data.data())), m_end(m_ptr + data.size()) { }
+
+  bool at_end() const { return m_ptr == m_end; }
+  size_t bytes_left() const { return m_end - m_ptr; }
+
+  // Used to read a value again.
+  using position_type = unsigned char const*;
+  position_type position() const { return m_ptr; }
+  void restore(position_type position) { m_ptr = position; }
+
+  size_t read_array_header();
+  size_t read_map_header();
+  std::string_view read_str();
+  std::string_view read_bin();
+  // Read any integer that fits in an int64_t.
+  int64_t read_integer();
+  // Read a float 32 or float 64, or an integer.
+  double read_double();
+  bool read_bool();
+  // Read a timestamp extension (the nanoseconds are ignored).
+  DateTime read_timestamp();
+
+  // Skip one value, including all elements of arrays and maps.
+  void skip();
+
+ private:
+  uint8_t read_byte()
+  {
+    if (m_ptr == m_end)
+      throw_truncated();
+    return *m_ptr++;
+  }
+
+  unsigned char const* read_bytes(size_t n)
+  {
+    if (static_cast<size_t>(m_end - m_ptr) < n)
+      throw_truncated();
+    unsigned char const* ptr = m_ptr;
+    m_ptr += n;
+    return ptr;
+  }
+
+  uint64_t read_big_endian(int size)
+  {
+    unsigned char const* ptr = read_bytes(size);
+    uint64_t value = 0;
+    for (int i = 0; i < size; ++i)
+      value = (value << 8) | ptr[i];
+    return value;
+  }
+
+  size_t read_size(uint8_t type, uint8_t fix, uint8_t fix_mask, uint8_t type8, uint8_t type16, char const* what);
+  [[noreturn]] static void throw_truncated();
+  [[noreturn]] static void throw_unexpected(uint8_t type, char const* expected);
+};
+
+} // namespace evio::protocol::xmlrpc
@@ -0,0 +1,87 @@
+#include "sys.h"
+#include "Multicall.h"
+#include "create_member_decoder.h"
+#include "utils/AIAlert.h"
+#include "debug.h"
+
+namespace evio::protocol::xmlrpc {
+
+ElementDecoder* MulticallFault::create_member_decoder(members member)
+{
+  switch (member)
+  {
+    case member_faultCode:
+      return xmlrpc::create_member_decoder(m_faultCode);
+    case member_faultString:
+      return xmlrpc::create_member_decoder(m_faultString);
+  }
+  AI_NEVER_REACHED
+}
+
+void MulticallResponse::CallResult::got_data()
+{
+  if (++m_values > 1)
+    THROW_ALERT("The result of a call in a system.multicall response has more than one value");
+}
+
+MulticallResponse::MulticallResponse(MulticallBatch&& batch) :
+  m_calls(std::move(batch.m_calls)), m_next_call(0), m_state(state_start), m_fault_decoder(m_fault, 0)
+{
+  batch.m_calls.clear();
+}
+
+ElementDecoder* MulticallResponse::get_array_decoder()
+{
+  if (m_state == state_start)
+  {
+    m_state = state_calls;
+    return this;
+  }
+  if (m_state != state_call)
+    THROW_ALERT("Unexpected <array>");
+  m_state = state_result;
+  m_call_result.reset(m_calls[m_next_call].m_response_decoder);
+  return &m_call_result;
+}
+
+ElementDecoder* MulticallResponse::get_struct_decoder()
+{
+  if (m_state != state_call)
+    THROW_ALERT("Unexpected <struct>");
+  m_state = state_fault;
+  m_fault.m_faultCode = 0;
+  m_fault.m_faultString.clear();
+  return &m_fault_decoder;
+}
+
+// Called at the start of the <value> of each call.
+void MulticallResponse::got_data()
+{
+  if (m_next_call == m_calls.size())
+    THROW_ALERT("Received more than [CALLS] results in response to a system.multicall", AIArgs("[CALLS]", m_calls.size()));
+  m_state = state_call;
+}
+
+void MulticallResponse::got_data_value_end()
+{
+  MulticallBatch::Call& call = m_calls[m_next_call];
+  MulticallFault const* fault = nullptr;
+  if (m_state == state_fault)
+    fault = &m_fault;
+  else if (m_state != state_result || m_call_result.values() != 1)
+    THROW_ALERT("Expected either an <array> with one value or a fault <struct> as result of call [CALL] of a system.multicall",
+        AIArgs("[CALL]", m_next_call));
+  ++m_next_call;
+  m_state = state_calls;
+  if (call.m_result_callback)
+    call.m_result_callback(fault);
+}
+
+void MulticallResponse::got_data_end()
+{
+  if (m_next_call != m_calls.size())
+    THROW_ALERT("Received [RESULTS] results in response to a system.multicall of [CALLS] calls",
+        AIArgs("[RESULTS]", m_next_call)("[CALLS]", m_calls.size()));
+}
+
+} // namespace evio::protocol::xmlrpc
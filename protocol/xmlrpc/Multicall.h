@@ -0,0 +1,148 @@
+#pragma once
+
+#include "ElementDecoder.h"
+#include "StructDecoder.h"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "debug.h"
+
+namespace evio::protocol::xmlrpc {
+
+class Request;
+class Encoder;
+
+// The fault struct that system.multicall returns in place of the result of a call that failed.
+struct MulticallFault
+{
+  enum members { member_faultCode, member_faultString };
+
+  int32_t m_faultCode;
+  std::string m_faultString;
+
+  ElementDecoder* create_member_decoder(members member);
+};
+
+// Collects requests that are sent together as one system.multicall.
+//
+// Usage:
+//
+//   xmlrpc::MulticallBatch batch(16, std::chrono::milliseconds(2));
+//
+//   // For each request.
+//   bool full = batch.add(request, response_decoder, [](xmlrpc::MulticallFault const* fault){ ... });
+//
+//   // When full, or when batch.deadline() passed.
+//   encoder << batch;
+//   auto response = std::make_unique<xmlrpc::MulticallResponse>(std::move(batch));    // Leaves batch empty.
+//   xmlrpc::Decoder decoder(*response);
+//
+// The results are decoded by the response_decoder of each request, the same decoder that
+// would be used if the request was sent on its own (for example a SingleStructResponse).
+// The requests and response decoders must stay alive until the response is decoded.
+//
+class MulticallBatch
+{
+ public:
+  using clock_type = std::chrono::steady_clock;
+  // Called after the result of a call was decoded with a null fault, or with the fault that was returned instead.
+  using result_callback_type = std::function<void(MulticallFault const* fault)>;
+
+ private:
+  friend class MulticallResponse;
+  friend Encoder& operator<<(Encoder& encoder, MulticallBatch const& batch);
+
+  struct Call
+  {
+    Request const* m_request;
+    ElementDecoder* m_response_decoder;
+    result_callback_type m_result_callback;
+  };
+
+  std::vector<Call> m_calls;
+  size_t const m_max_calls;
+  clock_type::duration const m_window;
+  clock_type::time_point m_deadline;    // The time that the batch must be sent, set when the first call is added.
+
+ public:
+  // Send at most max_calls requests in one system.multicall, and keep no request waiting longer than window.
+  MulticallBatch(size_t max_calls, clock_type::duration window) : m_max_calls(max_calls), m_window(window)
+  {
+    // max_calls must be at least one.
+    ASSERT(max_calls > 0);
+  }
+
+  // Add a request whose result must be decoded by response_decoder.
+  // Returns true if the batch is full and must be sent now.
+  bool add(Request const& request, ElementDecoder& response_decoder, result_callback_type result_callback = {})
+  {
+    if (m_calls.empty())
+      m_deadline = clock_type::now() + m_window;
+    m_calls.push_back({&request, &response_decoder, std::move(result_callback)});
+    return m_calls.size() >= m_max_calls;
+  }
+
+  // The time at which a non-empty batch must be sent.
+  clock_type::time_point deadline() const { return m_deadline; }
+  bool expired(clock_type::time_point now = clock_type::now()) const { return !m_calls.empty() && now >= m_deadline; }
+
+  bool empty() const { return m_calls.empty(); }
+  size_t size() const { return m_calls.size(); }
+};
+
+// Decodes the response to a system.multicall, passing the result of every call to the response decoder of its request.
+//
+// Each element of the returned array is either an array with the single result value of the call,
+// or a MulticallFault struct.
+class MulticallResponse : public ElementDecoder
+{
+ private:
+  // Skips the <array><data> around the result of a call and passes the value to the response decoder of the call.
+  class CallResult : public ElementDecoder
+  {
+   private:
+    ElementDecoder* m_response_decoder;
+    int m_values;                       // The number of values in the array.
+
+   public:
+    CallResult() : m_response_decoder(nullptr), m_values(0) { }
+
+    void reset(ElementDecoder* response_decoder) { m_response_decoder = response_decoder; m_values = 0; }
+    int values() const { return m_values; }
+
+   private:
+    ElementDecoder* get_struct_decoder() override { return m_response_decoder->get_struct_decoder(); }
+    ElementDecoder* get_array_decoder() override { return m_response_decoder->get_array_decoder(); }
+    void got_characters(std::string_view const& data, UTF8_SAX_Decoder const& source) override { m_response_decoder->got_characters(data, source); }
+    void got_data() override;
+  };
+
+  enum state_type {
+    state_start,                        // Before the <array> of results.
+    state_calls,                        // Between the results.
+    state_call,                         // In the <value> of a result, before its <array> or <struct>.
+    state_result,                       // In the <array> of a result.
+    state_fault                         // In the <struct> of a fault.
+  };
+
+  std::vector<MulticallBatch::Call> m_calls;
+  size_t m_next_call;                   // The index into m_calls of the current (or next) call.
+  state_type m_state;
+  CallResult m_call_result;
+  MulticallFault m_fault;
+  StructDecoder<MulticallFault> m_fault_decoder;
+
+ public:
+  MulticallResponse(MulticallBatch&& batch);
+
+ private:
+  ElementDecoder* get_struct_decoder() override;
+  ElementDecoder* get_array_decoder() override;
+  void got_data() override;
+  void got_data_value_end() override;
+  void got_data_end() override;
+};
+
+} // namespace evio::protocol::xmlrpc
@@ -18,7 +18,7 @@ class Request
   Request(std::string method_name = std::string{}) : m_method_name(std::move(method_name)) { }
 
  public:
-  std::string method_name() const { return m_method_name; }
+  std::string const& method_name() const { return m_method_name; }
   auto begin() const { return m_params.begin(); }
   auto end() const { return m_params.end(); }
 
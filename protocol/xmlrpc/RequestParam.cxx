@@ -1,13 +1,22 @@
 #include "sys.h"
 #include "RequestParam.h"
-#include <iostream>
+#include "Writer.h"
 #include "debug.h"
 
 namespace evio::protocol::xmlrpc {
 
-void RequestParam::write_param(std::ostream& output) const
+void RequestParam::write_param(Writer& UNUSED_ARG(writer)) const
 {
-  output << "<param />";
+}
+
+size_t RequestParam::msgpack_size() const
+{
+  return 1;
+}
+
+void RequestParam::write_msgpack(Writer& writer) const
+{
+  writer.write("\xc0");
 }
 
 } // namespace evio::protocol::xmlrpc
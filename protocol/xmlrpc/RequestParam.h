@@ -1,10 +1,12 @@
 #pragma once
 
-#include <string>
-#include <iosfwd>
+#include <cstddef>
+#include <string_view>
 
 namespace evio::protocol::xmlrpc {
 
+class Writer;
+
 class RequestParam
 {
  public:
@@ -12,7 +14,17 @@ class RequestParam
 
   virtual char const* method_name() const = 0;
 
-  virtual void write_param(std::ostream& output) const;
+  // The start of the encoding of this parameter that is the same for every object of this type.
+  // The returned text must live as long as the program; the Encoder caches it per method.
+  virtual std::string_view static_prefix() const { return {}; }
+
+  // Write the rest of the encoding of this parameter, after static_prefix().
+  virtual void write_param(Writer& writer) const;
+
+  // Write the MessagePack encoding of this parameter (see BinaryEncoder), which is msgpack_size() bytes.
+  // The default writes nil.
+  virtual size_t msgpack_size() const;
+  virtual void write_msgpack(Writer& writer) const;
 };
 
 } // namespace evio::protocol::xmlrpc
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+#include "debug.h"
+
+namespace evio::protocol::xmlrpc {
+
+// A member type to use instead of std::vector<T> for (large) arrays that should not be stored.
+//
+// Every element of the array is passed to a callback as soon as its </value>
+// was decoded, or collected in batches of at most batch_size elements. The
+// elements are destroyed after the callback returns, so that the memory used
+// stays constant regardless of the size of the array. Elements are discarded
+// when no callback was registered.
+//
+// Usage:
+//
+//   StreamedArray<Item> m_items;       // Instead of std::vector<Item> m_items.
+//
+//   response.m_items.on_element([](Item& item){ ... });
+//   // or
+//   response.m_items.on_batch(1000, [](std::vector<Item>& items){ ... });
+//
+template<typename T>
+class StreamedArray
+{
+ public:
+  using element_callback_type = std::function<void(T&)>;
+  using batch_callback_type = std::function<void(std::vector<T>&)>;
+
+ private:
+  std::vector<T> m_batch;               // The elements that were not passed to a callback yet.
+  size_t m_batch_size;
+  element_callback_type m_element_callback;
+  batch_callback_type m_batch_callback;
+  size_t m_count;                       // The number of elements received so far.
+
+ public:
+  StreamedArray() : m_batch_size(1), m_count(0) { }
+
+  void on_element(element_callback_type element_callback)
+  {
+    m_element_callback = std::move(element_callback);
+    m_batch_callback = nullptr;
+    m_batch_size = 1;
+  }
+
+  void on_batch(size_t batch_size, batch_callback_type batch_callback)
+  {
+    // batch_size must be at least one.
+    ASSERT(batch_size > 0);
+    m_batch_callback = std::move(batch_callback);
+    m_element_callback = nullptr;
+    m_batch_size = batch_size;
+    m_batch.reserve(batch_size);
+  }
+
+  size_t size() const { return m_count; }
+
+  // Used by StreamedArrayDecoder.
+  std::vector<T>& batch() { return m_batch; }
+
+  // Called after the last element of batch() was decoded.
+  void element_done()
+  {
+    ++m_count;
+    if (m_batch.size() >= m_batch_size)
+      flush();
+  }
+
+  // Pass the remaining elements to the callback.
+  void flush()
+  {
+    if (m_batch.empty())
+      return;
+    if (m_element_callback)
+      for (T& element : m_batch)
+        m_element_callback(element);
+    else if (m_batch_callback)
+      m_batch_callback(m_batch);
+    m_batch.clear();
+  }
+};
+
+} // namespace evio::protocol::xmlrpc
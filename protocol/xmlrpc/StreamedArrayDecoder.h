@@ -0,0 +1,29 @@
+#pragma once
+
+#include "StreamedArray.h"
+
+namespace evio::protocol::xmlrpc {
+
+// Decodes the elements of an array into StreamedArray<T>::batch() with ArrayDecoder
+// (ArrayOfStructDecoder<T> or ArrayOfMemberDecoder<T>), passing each one on when its </value> is reached.
+template<typename T, typename ArrayDecoder>
+class StreamedArrayDecoder : public ArrayDecoder
+{
+ private:
+  StreamedArray<T>& m_array;
+
+  void got_data_value_end() override
+  {
+    m_array.element_done();
+  }
+
+  void got_data_end() override
+  {
+    m_array.flush();
+  }
+
+ public:
+  StreamedArrayDecoder(StreamedArray<T>& array, int flags) : ArrayDecoder(array.batch(), flags), m_array(array) { }
+};
+
+} // namespace evio::protocol::xmlrpc
@@ -12,14 +12,10 @@ class StructDecoder : public StructDictionary<T>, public DecoderBase<T>
  protected:
   ElementDecoder* create_member_decoder(std::string_view const& name) override
   {
-    try
-    {
-      return this->m_member.create_member_decoder(this->get_member(name));
-    }
-    catch (typename StructDictionary<T>::UnknownMember const&)
-    {
+    auto member = this->get_member(name);
+    if (!member)
       return &IgnoreElement::s_ignore_element;
-    }
+    return this->m_member.create_member_decoder(*member);
   }
 
  private:
@@ -1,65 +1,219 @@
 #pragma once
 
 #include "IgnoreElement.h"
-#include "utils/Dictionary.h"
-#include "threadsafe/AIReadWriteMutex.h"
-#include "threadsafe/aithreadsafe.h"
 #include <magic_enum.hpp>
-#include "debug.h"
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string_view>
 
 namespace evio::protocol::xmlrpc {
 
-template<typename T>
-class StructDictionary {
- protected:
-  using dictionary_type = aithreadsafe::Wrapper<utils::Dictionary<typename T::members, int>, aithreadsafe::policy::ReadWrite<AIReadWriteMutex>>;
-  using UnknownMember = typename dictionary_type::data_type::NonExistingWord;
+namespace detail {
 
-  static dictionary_type s_dictionary;
+// XML RPC member names may contain a '-' where the enumerator has a '_'.
+constexpr char normalize_member_name_char(char c) { return c == '-' ? '_' : c; }
 
-  typename T::members get_member(std::string_view const& name);
+// Hash a member name, with '-' hashed as '_'.
+constexpr uint64_t member_name_hash(std::string_view name)
+{
+  uint64_t hash = name.size() * 0x9e3779b97f4a7c15ULL;
+  for (char c : name)
+    hash = (hash ^ static_cast<unsigned char>(normalize_member_name_char(c))) * 0x100000001b3ULL;
+  return hash;
+}
 
-  StructDictionary();
-};
+// The length and the first, middle and last two characters of a member name.
+// This is much cheaper than hashing the whole name, and distinguishes the members of most structs.
+constexpr uint64_t member_name_sample(std::string_view name)
+{
+  size_t const size = name.size();
+  if (size == 0)
+    return 0;
+  auto sample = [name](size_t i, int shift){ return static_cast<uint64_t>(static_cast<unsigned char>(normalize_member_name_char(name[i]))) << shift; };
+  return size | sample(0, 24) | sample(size / 2, 32) | sample(size - 1 - (size > 1), 40) | sample(size - 1, 48);
+}
 
-template<typename T>
-typename StructDictionary<T>::dictionary_type StructDictionary<T>::s_dictionary;
+// Replace every '-' in the eight characters of chunk with '_'.
+inline uint64_t normalize_member_name_chunk(uint64_t chunk)
+{
+  constexpr uint64_t ones = 0x0101010101010101ULL;
+  constexpr uint64_t low7 = 0x7f * ones;
+  uint64_t const t = chunk ^ ('-' * ones);
+  // The high bit of each byte that was a '-'.
+  uint64_t const dash = ~(((t & low7) + low7) | t | low7);
+  return chunk ^ ((dash >> 7) * ('-' ^ '_'));
+}
 
-template<typename T>
-StructDictionary<T>::StructDictionary()
+// Compare name, in which a '-' matches a '_', with the (enumerator) name known_name of the same size.
+inline bool member_name_equal(std::string_view name, std::string_view known_name)
 {
-  // Only initialize the (static) dictionary once!
-  // See https://stackoverflow.com/a/36596693/1487069
-  static bool once = [](){
-    typename dictionary_type::wat dictionary_w(s_dictionary);
-    for (int i = 0; i < magic_enum::enum_count<typename T::members>(); ++i)
+  size_t const size = name.size();
+  if (size < 8)
+  {
+    for (size_t i = 0; i < size; ++i)
+      if (normalize_member_name_char(name[i]) != known_name[i])
+        return false;
+    return true;
+  }
+  uint64_t chunk, known_chunk;
+  for (size_t pos = 0;; pos += 8)
+  {
+    // The last chunk overlaps with the previous one if size isn't a multiple of eight.
+    if (pos > size - 8)
+      pos = size - 8;
+    std::memcpy(&chunk, name.data() + pos, 8);
+    std::memcpy(&known_chunk, known_name.data() + pos, 8);
+    if (normalize_member_name_chunk(chunk) != known_chunk)
+      return false;
+    if (pos == size - 8)
+      return true;
+  }
+}
+
+// Mix a seed into a key (member_name_hash or member_name_sample), using the finalizer of MurmurHash3.
+constexpr uint32_t member_name_hash_seeded(uint64_t hash, uint32_t seed)
+{
+  hash ^= seed;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+// A perfect hash of the names of the enumerators of MEMBERS (without the "member_" prefix), generated at compile time.
+template<typename MEMBERS>
+struct MemberNameTable
+{
+  static constexpr size_t count = magic_enum::enum_count<MEMBERS>();
+  static constexpr size_t max_seeds = 10000;    // The number of seeds to try per table size.
+
+  static constexpr std::array<std::string_view, count> make_names()
+  {
+    std::array<std::string_view, count> names{};
+    constexpr auto enum_names = magic_enum::enum_names<MEMBERS>();
+    for (size_t i = 0; i < count; ++i)
+      names[i] = enum_names[i].substr(7);       // All member names start with "member_".
+    return names;
+  }
+
+  static constexpr bool has_member_prefix()
+  {
+    for (std::string_view name : magic_enum::enum_names<MEMBERS>())
+      if (name.substr(0, 7) != "member_")
+        return false;
+    return true;
+  }
+
+  static constexpr std::array<std::string_view, count> names = make_names();
+  static constexpr std::array<MEMBERS, count> values = magic_enum::enum_values<MEMBERS>();
+
+  static constexpr bool samples_are_unique()
+  {
+    for (size_t i = 0; i < count; ++i)
+      for (size_t j = i + 1; j < count; ++j)
+        if (member_name_sample(names[i]) == member_name_sample(names[j]))
+          return false;
+    return true;
+  }
+
+  // Only hash whole names when the samples of two names are the same.
+  static constexpr bool use_samples = samples_are_unique();
+
+  static constexpr uint64_t key(std::string_view name)
+  {
+    if constexpr (use_samples)
+      return member_name_sample(name);
+    else
+      return member_name_hash(name);
+  }
+
+  static constexpr std::array<uint64_t, count> make_keys()
+  {
+    std::array<uint64_t, count> keys{};
+    for (size_t i = 0; i < count; ++i)
+      keys[i] = key(names[i]);
+    return keys;
+  }
+
+  static constexpr std::array<uint64_t, count> keys = make_keys();
+
+  // Returns true if all names map to a different slot of a table with table_size entries.
+  static constexpr bool is_perfect(uint32_t seed, size_t table_size)
+  {
+    // table_size is less than 128 * count (see find_table_size).
+    uint64_t used[2 * (count ? count : 1)] = {};
+    for (uint64_t key : keys)
     {
-      typename T::members member = static_cast<typename T::members>(i);
-      std::string_view member_name = magic_enum::enum_name(member);
-      // All member names start with "member_".
-      ASSERT(member_name.substr(0, 7) == "member_");
-      member_name.remove_prefix(7);
-      dictionary_w->add(member, std::move(member_name));
+      size_t slot = member_name_hash_seeded(key, seed) & (table_size - 1);
+      uint64_t const bit = uint64_t{1} << (slot % 64);
+      if (used[slot / 64] & bit)
+        return false;
+      used[slot / 64] |= bit;
     }
     return true;
-  } ();
-}
+  }
+
+  static constexpr uint32_t find_seed(size_t table_size)
+  {
+    for (uint32_t seed = 1; seed <= max_seeds; ++seed)
+      if (is_perfect(seed, table_size))
+        return seed;
+    return 0;
+  }
+
+  // The smallest power of two of at least twice the number of names for which a perfect hash seed is found quickly.
+  static constexpr size_t find_table_size()
+  {
+    size_t table_size = 4;
+    while (table_size < 2 * count)
+      table_size <<= 1;
+    while (table_size < 64 * count && find_seed(table_size) == 0)
+      table_size <<= 1;
+    return table_size;
+  }
+
+  static constexpr size_t table_size = find_table_size();
+  static constexpr uint32_t seed = find_seed(table_size);
+  static_assert(has_member_prefix(), "All enumerators of T::members must start with \"member_\".");
+  static_assert(count <= 0xffff && (count == 0 || seed != 0), "No perfect hash found for the member names.");
+
+  static constexpr uint16_t empty_slot = 0xffff;
+
+  static constexpr std::array<uint16_t, table_size> make_table()
+  {
+    std::array<uint16_t, table_size> table{};
+    for (auto& entry : table)
+      entry = empty_slot;
+    for (size_t i = 0; i < count; ++i)
+      table[member_name_hash_seeded(keys[i], seed) & (table_size - 1)] = i;
+    return table;
+  }
+
+  static constexpr std::array<uint16_t, table_size> table = make_table();
+
+  // Returns the enumerator whose name matches name, or std::nullopt.
+  static std::optional<MEMBERS> lookup(std::string_view name)
+  {
+    uint16_t index = table[member_name_hash_seeded(key(name), seed) & (table_size - 1)];
+    if (index == empty_slot || names[index].size() != name.size() || !member_name_equal(name, names[index]))
+      return std::nullopt;
+    return values[index];
+  }
+};
+
+} // namespace detail
 
-// Throws StructDictionary<T>::UnknownMember if 'name' is not in T::members.
 template<typename T>
-typename T::members StructDictionary<T>::get_member(std::string_view const& name)
-{
-  int index;
-  typename dictionary_type::rat dictionary_r(s_dictionary);
-  if (name.find('-') == std::string_view::npos)
-    index = dictionary_r->index(name);
-  else
+class StructDictionary {
+ protected:
+  // Returns the member of T with the given XML RPC name, or std::nullopt if 'name' is not in T::members.
+  // A '-' in name matches a '_' in the name of the enumerator.
+  static std::optional<typename T::members> get_member(std::string_view const& name)
   {
-    std::string converted_name{name};
-    std::replace(converted_name.begin(), converted_name.end(), '-', '_'); // Replace al '-' with '_'.
-    index = dictionary_r->index(converted_name);
+    return detail::MemberNameTable<typename T::members>::lookup(name);
   }
-  return static_cast<typename T::members>(index);
-}
+};
 
 } // namespace evio::protocol::xmlrpc
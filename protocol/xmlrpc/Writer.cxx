@@ -0,0 +1,81 @@
+#include "sys.h"
+#include "Writer.h"
+#include "evio/StreamBuf.h"
+#include <ostream>
+#include "debug.h"
+
+namespace evio::protocol::xmlrpc {
+
+Writer::Writer(std::ostream& output) :
+  m_streambuf(output.rdbuf()), m_output_buffer(dynamic_cast<OutputBuffer*>(m_streambuf)), m_put(nullptr), m_put_end(nullptr), m_committed(nullptr)
+{
+  if (m_output_buffer)
+  {
+    m_committed = m_put = m_output_buffer->raw_pptr();
+    m_put_end = m_put + m_output_buffer->raw_available();
+  }
+}
+
+void Writer::commit()
+{
+  if (m_put != m_committed)
+  {
+    m_output_buffer->raw_pbump(m_put - m_committed);
+    m_committed = m_put;
+  }
+}
+
+char* Writer::reserve_slow(size_t n)
+{
+  if (!m_output_buffer)
+    return nullptr;
+  // The put area might have been changed by someone else. Note that we can't
+  // make the buffer allocate a new block here: that only happens when writing.
+  commit();
+  m_committed = m_put = m_output_buffer->raw_pptr();
+  m_put_end = m_put + m_output_buffer->raw_available();
+  return static_cast<size_t>(m_put_end - m_put) >= n ? m_put : nullptr;
+}
+
+void Writer::write_slow(std::string_view data)
+{
+  if (!m_output_buffer)
+  {
+    m_streambuf->sputn(data.data(), data.size());
+    return;
+  }
+  commit();
+  // This allocates new memory blocks as needed.
+  m_output_buffer->raw_sputn(data.data(), data.size());
+  m_committed = m_put = m_output_buffer->raw_pptr();
+  m_put_end = m_put + m_output_buffer->raw_available();
+}
+
+void Writer::write_escaped(std::string_view data)
+{
+  size_t begin = 0;
+  for (size_t pos = 0; pos < data.size(); ++pos)
+  {
+    std::string_view reference;
+    switch (data[pos])
+    {
+      case '&':
+        reference = "&amp;";
+        break;
+      case '<':
+        reference = "&lt;";
+        break;
+      case '>':
+        reference = "&gt;";
+        break;
+      default:
+        continue;
+    }
+    write(data.substr(begin, pos - begin));
+    write(reference);
+    begin = pos + 1;
+  }
+  write(data.substr(begin));
+}
+
+} // namespace evio::protocol::xmlrpc
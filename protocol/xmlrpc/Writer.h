@@ -0,0 +1,87 @@
+#pragma once
+
+#include <charconv>
+#include <cstring>
+#include <iosfwd>
+#include <streambuf>
+#include <string_view>
+#include <type_traits>
+
+namespace evio {
+class OutputBuffer;
+} // namespace evio
+
+namespace evio::protocol::xmlrpc {
+
+// Appends the text of an XML RPC message to the streambuf of an ostream.
+//
+// When that is an evio OutputBuffer (as is the case for an OutputStream),
+// everything is written directly into the contiguous put area of the buffer,
+// which is only made visible to the consumer (with one raw_pbump) when the
+// Writer is destructed or when the put area runs full. Other streambufs are
+// written to with sputn.
+//
+class Writer
+{
+ private:
+  std::streambuf* m_streambuf;
+  OutputBuffer* m_output_buffer;        // Non-null if m_streambuf is an OutputBuffer.
+  char* m_put;                          // Where to write next, in the put area of m_output_buffer.
+  char* m_put_end;                      // The end of the contiguous space at m_put.
+  char* m_committed;                    // Everything before this was passed to m_output_buffer with raw_pbump.
+
+ public:
+  explicit Writer(std::ostream& output);
+  ~Writer() { commit(); }
+
+  Writer(Writer const&) = delete;
+  Writer& operator=(Writer const&) = delete;
+
+  // Return a pointer to at least n bytes of contiguous space, or nullptr if that isn't available.
+  // Call advance with the end of what was written to it.
+  char* reserve(size_t n) { return static_cast<size_t>(m_put_end - m_put) >= n ? m_put : reserve_slow(n); }
+  void advance(char* end) { m_put = end; }
+
+  void write(std::string_view data)
+  {
+    if (char* ptr = reserve(data.size()))
+    {
+      std::memcpy(ptr, data.data(), data.size());
+      m_put = ptr + data.size();
+    }
+    else
+      write_slow(data);
+  }
+
+  // Write an integer or floating point value (the latter in fixed notation, the shortest that reads back the same value).
+  template<typename T>
+  void write_number(T value)
+  {
+    // The fixed notation of the largest double has 309 digits.
+    constexpr size_t max_size = std::is_floating_point_v<T> ? 330 : 24;
+    char buf[max_size];
+    char* ptr = reserve(max_size);
+    char* const begin = ptr ? ptr : buf;
+    char* end;
+    if constexpr (std::is_floating_point_v<T>)
+      end = std::to_chars(begin, begin + max_size, value, std::chars_format::fixed).ptr;
+    else
+      end = std::to_chars(begin, begin + max_size, value).ptr;
+    if (ptr)
+      m_put = end;
+    else
+      write_slow({buf, static_cast<size_t>(end - buf)});
+  }
+
+  // Write data with '&', '<' and '>' replaced by entity references.
+  void write_escaped(std::string_view data);
+
+  // Make everything that was written so far visible to the consumer of the buffer.
+  void commit();
+
+ private:
+  char* reserve_slow(size_t n);
+  void write_slow(std::string_view data);
+};
+
+} // namespace evio::protocol::xmlrpc
@@ -4,6 +4,7 @@
 #include "MemberDecoder.h"
 #include "ArrayOfStructDecoder.h"
 #include "ArrayOfMemberDecoder.h"
+#include "StreamedArrayDecoder.h"
 #include "debug.h"
 
 namespace evio::protocol::xmlrpc {
@@ -36,4 +37,13 @@ ElementDecoder* create_member_decoder(std::vector<T>& member)
     return new (ElementDecoder::s_pool) ArrayOfMemberDecoder<T>{member, 2};
 }
 
+template<typename T>
+ElementDecoder* create_member_decoder(StreamedArray<T>& member)
+{
+  if constexpr (has_members_v<T>)      // Is T a <struct>?
+    return new (ElementDecoder::s_pool) StreamedArrayDecoder<T, ArrayOfStructDecoder<T>>{member, 3};
+  else
+    return new (ElementDecoder::s_pool) StreamedArrayDecoder<T, ArrayOfMemberDecoder<T>>{member, 2};
+}
+
 } // namespace evio::protocol::xmlrpc
@@ -7,6 +7,10 @@
 #include "evio/DateTime.h"
 #include <charconv>
 
+namespace evio::protocol {
+class UTF8_SAX_Decoder;
+} // namespace evio::protocol
+
 namespace evio::protocol::xmlrpc {
 
 template<typename T>
@@ -29,11 +33,17 @@ inline void initialize(evio::DateTime& date_time, std::string_view const& iso860
   date_time.assign_from_iso8601_string(iso8601_data);
 }
 
+// XML RPC allows a leading '+', which std::from_chars doesn't.
+inline char const* skip_plus_sign(std::string_view const& data)
+{
+  return data.size() > 1 && data[0] == '+' && data[1] != '-' ? data.data() + 1 : data.data();
+}
+
 template<>
 inline void initialize(int32_t& value, std::string_view const& int_data)
 {
-  auto result = std::from_chars(int_data.begin(), int_data.end(), value);
-  if (result.ec == std::errc::invalid_argument || result.ptr != int_data.end())
+  auto result = std::from_chars(skip_plus_sign(int_data), int_data.data() + int_data.size(), value);
+  if (result.ec != std::errc() || result.ptr != int_data.data() + int_data.size())
   {
     THROW_ALERTC(result.ec, "Invalid characters [[DATA]] for integer", AIArgs("[DATA]", utils::print_using(int_data, utils::c_escape)));
   }
@@ -42,27 +52,20 @@ inline void initialize(int32_t& value, std::string_view const& int_data)
 template<>
 inline void initialize(double& value, std::string_view const& double_data)
 {
-  std::string data{double_data};
-  try
-  {
-    value = std::stod(data);
-  }
-  catch (std::invalid_argument const& error)
-  {
-    THROW_ALERT("Invalid characters [[DATA]] for floating point", AIArgs("[DATA]", utils::print_using(double_data, utils::c_escape)));
-  }
-  catch (std::out_of_range  const& error)
-  {
+  auto result = std::from_chars(skip_plus_sign(double_data), double_data.data() + double_data.size(), value);
+  if (result.ec == std::errc::result_out_of_range)
     THROW_ALERT("Data [[DATA]] is out of range for a double", AIArgs("[DATA]", utils::print_using(double_data, utils::c_escape)));
-  }
+  if (result.ec == std::errc::invalid_argument || result.ptr != double_data.data() + double_data.size())
+    THROW_ALERT("Invalid characters [[DATA]] for floating point", AIArgs("[DATA]", utils::print_using(double_data, utils::c_escape)));
 }
 
 template<>
 inline void initialize(bool& value, std::string_view const& bool_data)
 {
-  if (bool_data == "true" || bool_data == "Y")
+  // The XML RPC specification only allows 1 and 0.
+  if (bool_data == "1" || bool_data == "true" || bool_data == "Y")
     value = true;
-  else if (bool_data == "false" || bool_data == "N")
+  else if (bool_data == "0" || bool_data == "false" || bool_data == "N")
     value = false;
   else
   {
@@ -76,4 +79,11 @@ inline void initialize(std::string& value, std::string_view const& string_data)
   value = string_data;
 }
 
+// Called by the member decoders. Specialize this for types that keep referring to the received data (see LazyString).
+template<typename T>
+void initialize(T& member, std::string_view const& data, UTF8_SAX_Decoder const& UNUSED_ARG(source))
+{
+  initialize(member, data);
+}
+
 } // namespace evio::protocol::xmlrpc
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "MsgPackReader.h"
+#include "has_xmlrpc_names.h"
+#include "evio/DateTime.h"
+#include "evio/BinaryData.h"
+#include "utils/AIAlert.h"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Decoding of what write_msgpack.h encodes.
+
+namespace evio::protocol::xmlrpc {
+
+inline void read_msgpack(MsgPackReader& reader, bool& val)
+{
+  val = reader.read_bool();
+}
+
+inline void read_msgpack(MsgPackReader& reader, int32_t& val)
+{
+  int64_t value = reader.read_integer();
+  if (value < std::numeric_limits<int32_t>::min() || value > std::numeric_limits<int32_t>::max())
+    THROW_ALERT("MessagePack integer [VALUE] is out of range for int32_t", AIArgs("[VALUE]", value));
+  val = value;
+}
+
+inline void read_msgpack(MsgPackReader& reader, double& val)
+{
+  val = reader.read_double();
+}
+
+inline void read_msgpack(MsgPackReader& reader, std::string& val)
+{
+  val = reader.read_str();
+}
+
+inline void read_msgpack(MsgPackReader& reader, evio::DateTime& val)
+{
+  val = reader.read_timestamp();
+}
+
+inline void read_msgpack(MsgPackReader& reader, evio::BinaryData& val)
+{
+  val.assign_from_binary(reader.read_bin());
+}
+
+template<typename T>
+void read_msgpack(MsgPackReader& reader, std::vector<T>& val);
+
+template<typename T>
+typename std::enable_if<has_xmlrpc_names_v<T>, void>::type
+read_msgpack(MsgPackReader& reader, T& val);
+
+template<typename T>
+void read_msgpack(MsgPackReader& reader, std::vector<T>& val)
+{
+  size_t size = reader.read_array_header();
+  val.clear();
+  // The size is read from the wire: every element takes at least one byte, so don't reserve more than that.
+  val.reserve(std::min(size, reader.bytes_left()));
+  for (size_t i = 0; i < size; ++i)
+    read_msgpack(reader, val.emplace_back());
+}
+
+// Read the entries of a map into the members of S, which are expected in the order of S::s_xmlrpc_names.
+// Entries with an unknown name are skipped and members that are missing keep their value, so that
+// peers with an older or newer version of S can still talk to each other.
+template<typename S>
+struct MsgPackDeserializeMembers
+{
+  MsgPackReader& m_reader;
+  size_t m_member;
+  size_t m_remaining;                   // The number of map entries that weren't read yet.
+
+  MsgPackDeserializeMembers(MsgPackReader& reader, size_t size) : m_reader(reader), m_member(0), m_remaining(size) { }
+
+  bool is_later_member(std::string_view name) const
+  {
+    for (size_t i = m_member; i < S::s_xmlrpc_names.size(); ++i)
+      if (name == S::s_xmlrpc_names[i])
+        return true;
+    return false;
+  }
+
+  template<typename T>
+  void operator&(T& val)
+  {
+    std::string_view const member_name = S::s_xmlrpc_names[m_member++];
+    while (m_remaining > 0)
+    {
+      MsgPackReader::position_type const entry = m_reader.position();
+      std::string_view name = m_reader.read_str();
+      if (name == member_name)
+      {
+        --m_remaining;
+        read_msgpack(m_reader, val);
+        return;
+      }
+      if (is_later_member(name))
+      {
+        // This member is missing.
+        m_reader.restore(entry);
+        return;
+      }
+      m_reader.skip();
+      --m_remaining;
+    }
+  }
+
+  void skip_remaining()
+  {
+    for (; m_remaining > 0; --m_remaining)
+    {
+      m_reader.read_str();
+      m_reader.skip();
+    }
+  }
+};
+
+template<typename T>
+typename std::enable_if<has_xmlrpc_names_v<T>, void>::type
+read_msgpack(MsgPackReader& reader, T& val)
+{
+  MsgPackDeserializeMembers<T> dm(reader, reader.read_map_header());
+  val.serialize(dm, 0);
+  dm.skip_remaining();
+}
+
+} // namespace evio::protocol::xmlrpc
@@ -1,4 +1,5 @@
 #include "evio/protocol/xmlrpc/write_value.h"
+#include "evio/protocol/xmlrpc/write_msgpack.h"
 #include <iostream>
 
 namespace xmlrpc {
@@ -6,11 +7,26 @@ namespace xmlrpc {
 constexpr int XMLRPC_CLASSNAME_CREATE(ClassName)::s_number_of_members;
 constexpr std::array<char const*, XMLRPC_CLASSNAME_CREATE(ClassName)::s_number_of_members> XMLRPC_CLASSNAME_CREATE(ClassName)::s_xmlrpc_names;
 
-void ClassName::write_param(std::ostream& output) const
+std::string_view ClassName::static_prefix() const
 {
-  output << "<param>";
-  evio::protocol::xmlrpc::write_value(output, *this);
-  output << "</param>";
+  return evio::protocol::xmlrpc::StructFragments<XMLRPC_CLASSNAME_CREATE(ClassName)>::fragment(0);
+}
+
+void ClassName::write_param(evio::protocol::xmlrpc::Writer& writer) const
+{
+  evio::protocol::xmlrpc::write_struct_members(writer, static_cast<XMLRPC_CLASSNAME_CREATE(ClassName) const&>(*this));
+}
+
+size_t ClassName::msgpack_size() const
+{
+  evio::protocol::xmlrpc::MsgPackSize size;
+  evio::protocol::xmlrpc::write_msgpack(size, static_cast<XMLRPC_CLASSNAME_CREATE(ClassName) const&>(*this));
+  return size.m_size;
+}
+
+void ClassName::write_msgpack(evio::protocol::xmlrpc::Writer& writer) const
+{
+  evio::protocol::xmlrpc::write_msgpack(writer, static_cast<XMLRPC_CLASSNAME_CREATE(ClassName) const&>(*this));
 }
 
 #ifdef CWDEBUG
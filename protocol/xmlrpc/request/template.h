@@ -55,7 +55,10 @@ class XMLRPC_CLASSNAME_CREATE(ClassName)
 class ClassName : public XMLRPC_CLASSNAME_CREATE(ClassName), public evio::protocol::xmlrpc::Request, public evio::protocol::xmlrpc::RequestParam
 {
  private:
-  void write_param(std::ostream& output) const override;
+  std::string_view static_prefix() const override;
+  void write_param(evio::protocol::xmlrpc::Writer& writer) const override;
+  size_t msgpack_size() const override;
+  void write_msgpack(evio::protocol::xmlrpc::Writer& writer) const override;
 
  public:
   ClassName(XMLRPC_CLASSNAME_CREATE(ClassName)&& params) : XMLRPC_CLASSNAME_CREATE(ClassName){std::move(params)}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include "evio/DateTime.h"
+#include "evio/BinaryData.h"
+#include "has_xmlrpc_names.h"
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Encoding of the same types as write_value.h, but as MessagePack (https://github.com/msgpack/msgpack/blob/master/spec.md).
+//
+// A struct is encoded as a map from its XML RPC member names to the values of its members.
+// The functions are templates over the writer W, which is either a Writer or a MsgPackSize.
+
+namespace evio::protocol::xmlrpc {
+
+// A writer that only counts the bytes; used to determine the length prefix of a message before writing it.
+struct MsgPackSize
+{
+  size_t m_size = 0;
+  void write(std::string_view data) { m_size += data.size(); }
+};
+
+namespace msgpack {
+
+// Write type followed by the size bytes of value in big endian.
+template<typename W>
+void write_big_endian(W& writer, uint8_t type, uint64_t value, int size)
+{
+  char buf[9];
+  buf[0] = type;
+  for (int i = size; i > 0; --i)
+  {
+    buf[i] = static_cast<char>(value);
+    value >>= 8;
+  }
+  writer.write({buf, static_cast<size_t>(size) + 1});
+}
+
+// Write the header of a str, bin, array or map of size elements: the fix type fix (if size is less than fix_limit),
+// or type8 (if non-zero and size fits in a byte), type16 or type16 + 1 (the 32-bit type) followed by the size.
+template<typename W>
+void write_header(W& writer, size_t size, uint8_t fix, size_t fix_limit, uint8_t type8, uint8_t type16)
+{
+  if (size < fix_limit)
+  {
+    char c = static_cast<char>(fix | size);
+    writer.write({&c, 1});
+  }
+  else if (type8 && size <= 0xff)
+    write_big_endian(writer, type8, size, 1);
+  else if (size <= 0xffff)
+    write_big_endian(writer, type16, size, 2);
+  else
+    write_big_endian(writer, type16 + 1, size, 4);
+}
+
+template<typename W>
+void write_str(W& writer, std::string_view str)
+{
+  write_header(writer, str.size(), 0xa0, 32, 0xd9, 0xda);
+  writer.write(str);
+}
+
+template<typename W>
+void write_array_header(W& writer, size_t size)
+{
+  write_header(writer, size, 0x90, 16, 0, 0xdc);
+}
+
+template<typename W>
+void write_map_header(W& writer, size_t size)
+{
+  write_header(writer, size, 0x80, 16, 0, 0xde);
+}
+
+} // namespace msgpack
+
+template<typename W>
+void write_msgpack(W& writer, bool val)
+{
+  char c = val ? '\xc3' : '\xc2';
+  writer.write({&c, 1});
+}
+
+template<typename W>
+void write_msgpack(W& writer, int32_t val)
+{
+  if (-32 <= val && val < 128)
+  {
+    // Positive or negative fixint.
+    char c = static_cast<char>(val);
+    writer.write({&c, 1});
+  }
+  else if (-128 <= val && val < 128)
+    msgpack::write_big_endian(writer, 0xd0, static_cast<uint32_t>(val), 1);
+  else if (-32768 <= val && val < 32768)
+    msgpack::write_big_endian(writer, 0xd1, static_cast<uint32_t>(val), 2);
+  else
+    msgpack::write_big_endian(writer, 0xd2, static_cast<uint32_t>(val), 4);
+}
+
+template<typename W>
+void write_msgpack(W& writer, double val)
+{
+  uint64_t bits;
+  std::memcpy(&bits, &val, sizeof(bits));
+  msgpack::write_big_endian(writer, 0xcb, bits, 8);
+}
+
+template<typename W>
+void write_msgpack(W& writer, std::string const& val)
+{
+  msgpack::write_str(writer, val);
+}
+
+// A DateTime is written as a timestamp extension (type -1).
+template<typename W>
+void write_msgpack(W& writer, evio::DateTime const& val)
+{
+  int64_t const seconds = val.posix_time();
+  if (0 <= seconds && seconds <= 0xffffffff)
+  {
+    // timestamp 32.
+    char header[2] = { '\xd6', '\xff' };
+    writer.write({header, 2});
+    char buf[4] = { static_cast<char>(seconds >> 24), static_cast<char>(seconds >> 16), static_cast<char>(seconds >> 8), static_cast<char>(seconds) };
+    writer.write({buf, 4});
+  }
+  else
+  {
+    // timestamp 96, with zero nanoseconds.
+    char header[7] = { '\xc7', 12, '\xff', 0, 0, 0, 0 };
+    writer.write({header, 7});
+    char buf[8];
+    for (int i = 0; i < 8; ++i)
+      buf[i] = static_cast<char>(static_cast<uint64_t>(seconds) >> (56 - 8 * i));
+    writer.write({buf, 8});
+  }
+}
+
+template<typename W>
+void write_msgpack(W& writer, evio::BinaryData const& val)
+{
+  std::string_view const data = val.binary_view();
+  msgpack::write_header(writer, data.size(), 0, 0, 0xc4, 0xc5);
+  writer.write(data);
+}
+
+template<typename W, typename T>
+void write_msgpack(W& writer, std::vector<T> const& val)
+{
+  msgpack::write_array_header(writer, val.size());
+  for (auto&& element : val)
+    write_msgpack(writer, element);
+}
+
+template<typename S, typename W>
+struct MsgPackSerializeMembers
+{
+  W& m_writer;
+  size_t m_member;
+
+  MsgPackSerializeMembers(W& writer) : m_writer(writer), m_member(0) { }
+
+  template<typename T>
+  void operator&(T const& val)
+  {
+    msgpack::write_str(m_writer, S::s_xmlrpc_names[m_member]);
+    write_msgpack(m_writer, val);
+    ++m_member;
+  }
+};
+
+template<typename W, typename T>
+typename std::enable_if<has_xmlrpc_names_v<T>, void>::type
+write_msgpack(W& writer, T const& val)
+{
+  msgpack::write_map_header(writer, T::s_xmlrpc_names.size());
+  MsgPackSerializeMembers<T, W> sm(writer);
+  const_cast<T&>(val).serialize(sm, 0);
+}
+
+} // namespace evio::protocol::xmlrpc
@@ -1,90 +1,185 @@
 #pragma once
 
+#include "Writer.h"
 #include "evio/DateTime.h"
 #include "evio/BinaryData.h"
 #include "has_xmlrpc_names.h"
+#include <array>
 #include <vector>
-#include <iostream>
 #include <cstdint>
 #include <string>
+#include <string_view>
 
 namespace evio::protocol::xmlrpc {
 
-void write_value(std::ostream& os, bool val)
+inline void write_value(Writer& writer, bool val)
 {
-  os << "<value><boolean>" << val << "</boolean></value>";
+  writer.write(val ? "<value><boolean>1</boolean></value>" : "<value><boolean>0</boolean></value>");
 }
 
-void write_value(std::ostream& os, int32_t val)
+inline void write_value(Writer& writer, int32_t val)
 {
-  os << "<value><i4>" << val << "</i4></value>";
+  writer.write("<value><i4>");
+  writer.write_number(val);
+  writer.write("</i4></value>");
 }
 
-void write_value(std::ostream& os, double val)
+inline void write_value(Writer& writer, double val)
 {
-  os << "<value><double>" << val << "</double></value>";
+  writer.write("<value><double>");
+  writer.write_number(val);
+  writer.write("</double></value>");
 }
 
-void write_value(std::ostream& os, std::string const& val)
+inline void write_value(Writer& writer, std::string const& val)
 {
-  os << "<value><string>" << val << "</string></value>";
+  writer.write("<value><string>");
+  writer.write_escaped(val);
+  writer.write("</string></value>");
 }
 
-void write_value(std::ostream& os, evio::DateTime const& val)
+inline void write_value(Writer& writer, evio::DateTime const& val)
 {
-  os << "<value><dateTime.iso8601>" << val.to_iso8601_string() << "</dateTime.iso8601></value";
+  writer.write("<value><dateTime.iso8601>");
+  if (char* ptr = writer.reserve(evio::DateTime::iso8601_max_size))
+    writer.advance(ptr + val.to_iso8601(ptr));
+  else
+  {
+    char buf[evio::DateTime::iso8601_max_size];
+    writer.write({buf, val.to_iso8601(buf)});
+  }
+  writer.write("</dateTime.iso8601></value>");
 }
 
-void write_value(std::ostream& os, evio::BinaryData const& val)
+inline void write_value(Writer& writer, evio::BinaryData const& val)
 {
-  os << "<value><base64>" << val.to_base64_string() << "</base64></value";
+  writer.write("<value><base64>");
+  if (char* ptr = writer.reserve(val.base64_size()))
+    writer.advance(val.to_base64(ptr));
+  else
+    writer.write(val.to_base64_string());
+  writer.write("</base64></value>");
 }
 
 template<typename T>
-void write_value(std::ostream& os, std::vector<T> const& val)
+void write_value(Writer& writer, std::vector<T> const& val)
 {
-  os << "<value><array><data>";
+  writer.write("<value><array><data>");
   for (auto&& element : val)
-    write_value(os, element);
-  os << "</data></array></value>";
+    write_value(writer, element);
+  writer.write("</data></array></value>");
 }
 
+// The constant text of the XML RPC encoding of a struct S, rendered at compile time from S::s_xmlrpc_names.
+//
+// fragment(0) is written before the value of the first member (for example
+// "<value><struct><member><name>foo</name>"), fragment(i) for 0 < i < count
+// between the values of member i - 1 and member i, and fragment(count) after
+// the last value ("</member></struct></value>"). If S has no members then
+// fragment(0) is the whole struct.
 template<typename S>
-struct SerializeMembers
+struct StructFragments
 {
-  std::ostream& m_output;
-  int m_member;
+  static constexpr size_t count = S::s_xmlrpc_names.size();
 
-  SerializeMembers(std::ostream& output) : m_output(output), m_member(0) { }
+  static constexpr std::string_view struct_begin = "<value><struct>";
+  static constexpr std::string_view member_begin = "<member><name>";
+  static constexpr std::string_view name_end = "</name>";
+  static constexpr std::string_view member_end = "</member>";
+  static constexpr std::string_view struct_end = "</struct></value>";
 
-  void write_member_prefix()
+  static constexpr size_t text_size()
   {
-    m_output << "<member><name>" << S::s_xmlrpc_names[m_member] << "</name>";
-    ++m_member;
+    size_t size = struct_begin.size() + struct_end.size();
+    for (std::string_view name : S::s_xmlrpc_names)
+      size += member_begin.size() + name.size() + name_end.size() + member_end.size();
+    return size;
+  }
+
+  // Returns the offsets of the fragments in text, followed by the size of text.
+  static constexpr std::array<size_t, count + 2> render(std::array<char, text_size()>* text)
+  {
+    std::array<size_t, count + 2> offsets{};
+    size_t pos = 0;
+    auto append = [text, &pos](std::string_view str){
+      for (char c : str)
+      {
+        if (text)
+          (*text)[pos] = c;
+        ++pos;
+      }
+    };
+    append(struct_begin);
+    for (size_t i = 0; i < count; ++i)
+    {
+      if (i > 0)
+      {
+        offsets[i] = pos;
+        append(member_end);
+      }
+      append(member_begin);
+      append(S::s_xmlrpc_names[i]);
+      append(name_end);
+    }
+    offsets[count] = count > 0 ? pos : 0;
+    if (count > 0)
+      append(member_end);
+    append(struct_end);
+    offsets[count + 1] = pos;
+    return offsets;
+  }
+
+  static constexpr std::array<char, text_size()> render_text()
+  {
+    std::array<char, text_size()> text{};
+    render(&text);
+    return text;
   }
 
-  void write_member_postfix()
+  static constexpr std::array<char, text_size()> text = render_text();
+  static constexpr std::array<size_t, count + 2> offsets = render(nullptr);
+
+  static constexpr std::string_view fragment(size_t i)
   {
-    m_output << "</member>";
+    return {text.data() + offsets[i], offsets[i + 1] - offsets[i]};
   }
+};
+
+template<typename S>
+struct SerializeMembers
+{
+  Writer& m_writer;
+  size_t m_member;
+
+  SerializeMembers(Writer& writer) : m_writer(writer), m_member(0) { }
 
   template<typename T>
   void operator&(T const& val)
   {
-    write_member_prefix();
-    write_value(m_output, val);
-    write_member_postfix();
+    // The fragment before the first member is written by the caller.
+    if (m_member > 0)
+      m_writer.write(StructFragments<S>::fragment(m_member));
+    write_value(m_writer, val);
+    ++m_member;
   }
 };
 
+// Write the members of val, and the end of the struct, after StructFragments<T>::fragment(0) was written.
 template<typename T>
-typename std::enable_if<has_xmlrpc_names_v<T>, void>::type
-write_value(std::ostream& os, T const& val)
+void write_struct_members(Writer& writer, T const& val)
 {
-  os << "<value><struct>";
-  SerializeMembers<T> sm(os);
+  SerializeMembers<T> sm(writer);
   const_cast<T&>(val).serialize(sm, 0);
-  os << "</struct></value>";
+  if constexpr (StructFragments<T>::count > 0)
+    writer.write(StructFragments<T>::fragment(StructFragments<T>::count));
+}
+
+template<typename T>
+typename std::enable_if<has_xmlrpc_names_v<T>, void>::type
+write_value(Writer& writer, T const& val)
+{
+  writer.write(StructFragments<T>::fragment(0));
+  write_struct_members(writer, val);
 }
 
 } // namespace evio::protocol::xmlrpc